@@ -0,0 +1,748 @@
+// Wire microbenchmarks.
+// build: g++ bench.cc -std=c++11 -O2 -o bench (add -DWIRE_STATS to also dump wire's own counters)
+// usage: ./bench [iterations] [--json] [--filter text] [--sizes 16,256,4096]
+//
+// Every case reports ns/op, heap bytes/op, allocations/op and peak heap growth. Cases named
+// std::... are baselines written against the standard library only. --json prints one
+// machine-readable document instead of the table, for diffing across wire versions.
+
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <unordered_map>
+
+#define WIRE_MMAP
+#include "wire.hpp"
+
+// global allocation counters. Blocks carry their size, so live and peak heap bytes are tracked too.
+// Kept out of line: once inlined, gcc misreads the size header and the malloc/free pairing.
+#if defined(__GNUC__)
+#   define bench$noinline __attribute__((noinline))
+#else
+#   define bench$noinline
+#endif
+static size_t allocations = 0, allocated = 0, live = 0, peak = 0;
+
+bench$noinline void *operator new( size_t n ) {
+    ++allocations;
+    allocated += n;
+    if( void *ptr = std::malloc( n + 16 ) ) {
+        *(size_t *)ptr = n;
+        if( ( live += n ) > peak ) peak = live;
+        return (char *)ptr + 16;
+    }
+    throw std::bad_alloc();
+}
+bench$noinline void operator delete( void *ptr ) noexcept {
+    if( !ptr ) return;
+    ptr = (char *)ptr - 16;
+    live -= *(size_t *)ptr;
+    std::free( ptr );
+}
+void operator delete( void *ptr, size_t ) noexcept {
+    operator delete( ptr );
+}
+
+static volatile size_t sink = 0;
+
+struct result {
+    std::string group, name;
+    size_t size, iterations;
+    bool baseline;
+    double ns, bytes, allocs, peak_kb;
+};
+static std::vector< result > results;
+static std::string group, filter;
+static bool json = false;
+
+// size is the input size the case was parameterized on (0 when fixed)
+template< typename FN >
+void bench( const std::string &name, size_t iterations, FN fn, size_t size = 0 ) {
+    if( !filter.empty() && name.find( filter ) == std::string::npos && group.find( filter ) == std::string::npos )
+        return;
+    typedef std::chrono::steady_clock clock;
+    iterations = iterations ? iterations : 1;
+    size_t allocs = allocations, bytes = allocated, base = live;
+    peak = live;
+    clock::time_point start = clock::now();
+    for( size_t i = 0; i < iterations; ++i )
+        sink = sink + fn( i );
+    double ns = std::chrono::duration< double, std::nano >( clock::now() - start ).count();
+    // read the counters before building the record, which allocates
+    double per_op[] = { ns, double( allocated - bytes ), double( allocations - allocs ) };
+    result r = { group, name, size, iterations, name.compare( 0, 5, "std::" ) == 0, per_op[0] / iterations,
+        per_op[1] / iterations, per_op[2] / iterations, double( peak - base ) / 1024 };
+    results.push_back( r );
+    if( !json )
+        std::printf( "%-48s %10.1f ns/op %8.2f allocs/op %10.1f KB peak\n", name.c_str(), r.ns, r.allocs, r.peak_kb );
+}
+
+std::string quoted( const std::string &text ) {
+    std::string out = "\"";
+    for( char c : text ) {
+        if( c == '"' || c == '\\' ) out += '\\', out += c;
+        else if( (unsigned char)c < 0x20 ) out += wire::format( "\\u%04x", c );
+        else out += c;
+    }
+    return out + "\"";
+}
+
+void print_json( size_t N ) {
+    std::printf( "{\n  \"iterations\": %zu,\n  \"results\": [", N );
+    for( size_t i = 0; i < results.size(); ++i ) {
+        const result &r = results[i];
+        std::printf( "%s\n    { \"group\": %s, \"name\": %s, \"size\": %zu, \"baseline\": %s, \"iterations\": %zu, "
+            "\"ns_per_op\": %.2f, \"bytes_per_op\": %.2f, \"allocs_per_op\": %.3f, \"peak_kb\": %.2f }",
+            i ? "," : "", quoted( r.group ).c_str(), quoted( r.name ).c_str(), r.size, r.baseline ? "true" : "false",
+            r.iterations, r.ns, r.bytes, r.allocs, r.peak_kb );
+    }
+    std::printf( "\n  ]\n}\n" );
+}
+
+int main( int argc, const char **argv ) {
+    size_t N = 1000000;
+    static std::vector< size_t > sizes = { 16, 256, 4096 };
+    for( int i = 1; i < argc; ++i ) {
+        std::string arg = argv[i];
+        if( arg == "--json" ) json = true;
+        else if( arg == "--filter" && i + 1 < argc ) filter = argv[++i];
+        else if( arg == "--sizes" && i + 1 < argc ) {
+            sizes.clear();
+            for( const wire::string &n : wire::string( argv[++i] ).tokenize( "," ) ) sizes.push_back( n.as<size_t>() );
+        }
+        else N = std::strtoul( argv[i], 0, 10 );
+    }
+
+    /* safe formatting */ {
+        group = "safe formatting";
+        bench( "wire::string( \"\\1=\\2;\", name, int )", N, []( size_t i ) {
+            return wire::string( "\1=\2;", "health", int(i) ).size();
+        } );
+        static const wire::fmt kv( "\1=\2;" );
+        bench( "wire::fmt( \"\\1=\\2;\" )( name, int )", N, []( size_t i ) {
+            return kv( "health", int(i) ).size();
+        } );
+        static std::string reused;
+        bench( "wire::fmt( \"\\1=\\2;\" ).to( reused, name, int )", N, []( size_t i ) {
+            return kv.to( reused, "health", int(i) ).size();
+        } );
+
+        bench( "wire::string( 7 args )", N, []( size_t i ) {
+            return wire::string( "hello \1 \2 \3 \4 \5 \6 \7", "world", 3.14159f, i, false, '\x1', "x", 0 ).size();
+        } );
+        static const wire::fmt seven( "hello \1 \2 \3 \4 \5 \6 \7" );
+        bench( "wire::fmt( 7 args )", N, []( size_t i ) {
+            return seven( "world", 3.14159f, i, false, '\x1', "x", 0 ).size();
+        } );
+
+        static wire::string line;
+        bench( "wire::string::operator()( name, int, ... ) reused", N, []( size_t i ) {
+            line = "\1: \2 (\3) at \4 from the \5 subsystem";
+            return line( "warning", int(i), 3.5f, "worker", "network" ).size();
+        } );
+    }
+
+    /* number conversion */ {
+        group = "number conversion";
+        bench( "std::stringstream << int", N, []( size_t i ) {
+            std::stringstream ss;
+            ss << int(i) - 500000;
+            return ss.str().size();
+        } );
+        bench( "wire::string( int )", N, []( size_t i ) {
+            return wire::string( int(i) - 500000 ).size();
+        } );
+        bench( "std::stringstream << double", N, []( size_t i ) {
+            std::stringstream ss;
+            ss << (long double)( i * 0.37 );
+            return ss.str().size();
+        } );
+        bench( "wire::string( double )", N, []( size_t i ) {
+            return wire::string( i * 0.37 ).size();
+        } );
+        static wire::string chain;
+        bench( "wire::string << int << int << double", N, []( size_t i ) {
+            chain.clear();
+            return ( chain << 3 << -int(i) << 99.95 ).size();
+        } );
+    }
+
+    /* parsing */ {
+        group = "parsing";
+        static const wire::string integers[] = { "123", "-456789", "2147483647", "0" };
+        static const wire::string reals[] = { "3.14159", "-0.001", "99.95", "1e10" };
+        bench( "std::istringstream >> int", N, []( size_t i ) {
+            int v = 0;
+            std::istringstream( static_cast< const std::string & >( integers[ i & 3 ] ) ) >> v;
+            return size_t( v );
+        } );
+        bench( "wire::string::as<int>()", N, []( size_t i ) {
+            return size_t( integers[ i & 3 ].as<int>() );
+        } );
+        bench( "std::istringstream >> double", N, []( size_t i ) {
+            double v = 0;
+            std::istringstream( static_cast< const std::string & >( reals[ i & 3 ] ) ) >> v;
+            return size_t( v );
+        } );
+        bench( "wire::string::as<double>()", N, []( size_t i ) {
+            return size_t( reals[ i & 3 ].as<double>() );
+        } );
+    }
+
+    /* c-style formatting */ {
+        group = "c-style formatting";
+        bench( "wire::format( \"%s: %d (%.2f)\" )", N, []( size_t i ) {
+            return wire::format( "%s: %d (%.2f)", "requests served", int(i), i * 0.5 ).size();
+        } );
+        static std::string stats;
+        bench( "wire::format_to( reused, \"%s: %d (%.2f)\" )", N, []( size_t i ) {
+            return wire::format_to( stats, "%s: %d (%.2f)", "requests served", int(i), i * 0.5 ).size();
+        } );
+    }
+
+    /* wildcards */ {
+        group = "wildcards";
+        static const wire::string subject = std::string( 200, 'a' );
+        bench( "wire::string::matches( \"*a*a*a*a*b\" ) on 200 bytes", N / 100, []( size_t ) {
+            return size_t( subject.matches( "*a*a*a*a*b" ) );
+        } );
+        static const wire::glob pattern( "*a*a*a*a*b" );
+        bench( "wire::glob( \"*a*a*a*a*b\" ) on 200 bytes", N / 100, []( size_t ) {
+            return size_t( pattern.matches( subject ) );
+        } );
+        static const wire::string header = "Content-Type";
+        bench( "wire::string::matchesi( \"content-*\" )", N, []( size_t ) {
+            return size_t( header.matchesi( "content-*" ) );
+        } );
+        static const wire::glob content( "content-*", true );
+        bench( "wire::glob( \"content-*\", icase )", N, []( size_t ) {
+            return size_t( content.matches( header ) );
+        } );
+    }
+
+    /* multi-pattern replacement */ {
+        group = "multi-pattern replacement";
+        static std::map< std::string, std::string > map;
+        for( int i = 0; i < 300; ++i )
+            map[ wire::string( "$\1$", i ) ] = wire::string( "value-\1", i * 7 );
+        static std::string text;
+        for( int i = 0; text.size() < ( 1 << 18 ); ++i )
+            text += wire::string( "lorem ipsum $\1$ dolor sit amet, ", i % 400 );
+
+        static const wire::string input = text;
+        bench( "std::string naive replace_map, 300 keys, 256 KB", 1, []( size_t ) {
+            std::string out;
+            for( size_t i = 0; i < text.size(); ) {
+                bool found = false;
+                for( auto it = map.rbegin(); !found && it != map.rend(); ++it )
+                    if( text.size() - i >= it->first.size() && !text.compare( i, it->first.size(), it->first ) )
+                        out += it->second, i += it->first.size(), found = true;
+                if( !found ) out += text[ i++ ];
+            }
+            return out.size();
+        } );
+        bench( "wire::string::replace_map( map ), 300 keys, 256 KB", 10, []( size_t ) {
+            return input.replace_map( map ).size();
+        } );
+        static const wire::replacer precompiled( map );
+        bench( "wire::replacer( map ), 300 keys, 256 KB", 10, []( size_t ) {
+            return input.replace_map( precompiled ).size();
+        } );
+    }
+
+    /* substring search */ {
+        group = "substring search";
+        for( size_t mb = 1; mb <= 16; mb *= 4 ) {
+            static wire::string text;
+            text.assign( mb << 20, 'x' );
+            for( size_t i = 0; i + 16 < text.size(); i += 997 )
+                text.std::string::replace( i, 7, "needle!" );
+
+            std::string label = wire::string( "\1 MB", mb );
+            size_t size = mb << 20;
+            bench( "std::string::find loop count, " + label, 4, []( size_t ) {
+                size_t n = 0;
+                for( size_t pos = 0; ( pos = text.find( "needle!", pos ) ) != std::string::npos; pos += 7 ) ++n;
+                return n;
+            }, size );
+            bench( "wire::string::count(), " + label, 4, []( size_t ) {
+                return text.count( "needle!" );
+            }, size );
+            // quadratic: every hit shifts the whole tail, so only the smallest size is measured
+            if( mb == 1 ) bench( "std::string::replace loop, " + label, 1, []( size_t ) {
+                std::string s = text;
+                for( size_t pos = 0; ( pos = s.find( "needle!", pos ) ) != std::string::npos; pos += 4 )
+                    s.replace( pos, 7, "pin" );
+                return s.size();
+            }, size );
+            bench( "wire::string::replace(), " + label, 4, []( size_t ) {
+                return text.replace( "needle!", "pin" ).size();
+            }, size );
+        }
+    }
+
+    /* case conversion */ {
+        group = "case conversion";
+        static const wire::string text = std::string( 4096, 'x' ) + "Content-Type: TEXT/html; charset=UTF-8";
+        bench( "std::toupper loop, 4 KB", N / 10, []( size_t ) {
+            std::string s = text;
+            for( size_t i = 0; i < s.size(); ++i ) s[i] = char( std::toupper( (unsigned char)s[i] ) );
+            return s.size();
+        } );
+        bench( "wire::string::uppercase(), 4 KB", N / 10, []( size_t ) {
+            return text.uppercase().size();
+        } );
+        static const wire::string other = text.lowercase();
+        bench( "uppercase() == uppercase(), 4 KB", N / 10, []( size_t ) {
+            return size_t( text.uppercase() == other.uppercase() );
+        } );
+        bench( "wire::string::equalsi(), 4 KB", N / 10, []( size_t ) {
+            return size_t( text.equalsi( other ) );
+        } );
+        static const wire::string header = "Content-Type: text/html";
+        bench( "wire::string::starts_withi( \"content-type:\" )", N, []( size_t ) {
+            return size_t( header.starts_withi( "content-type:" ) );
+        } );
+    }
+
+    /* tokenizing */ {
+        group = "tokenizing";
+        static wire::string log;
+        for( int i = 0; log.size() < ( 1 << 20 ); ++i )
+            log += wire::string( "2016-04-18 12:00:\1 worker-\2 GET /index.html?id=\3 200, 5120 bytes\n", i % 60, i % 8, i );
+        bench( "wire::string::tokenize( \" ,\\n\" ), 1 MB", 10, []( size_t ) {
+            return log.tokenize( " ,\n" ).size();
+        } );
+        bench( "wire::string::tokenize_view( \" ,\\n\" ), 1 MB", 10, []( size_t ) {
+            size_t n = 0;
+            for( wire::view token : log.tokenize_view( " ,\n" ) ) n += token.size();
+            return n;
+        } );
+        bench( "wire::string::split( \" ,\\n\" ), 1 MB", 10, []( size_t ) {
+            return log.split( " ,\n" ).size();
+        } );
+        bench( "wire::string::split_view( \" ,\\n\" ), 1 MB", 10, []( size_t ) {
+            size_t n = 0;
+            for( wire::view piece : log.split_view( " ,\n" ) ) n += piece.size();
+            return n;
+        } );
+        bench( "wire::token_stream( istream, \" ,\\n\" ), 1 MB", 10, []( size_t ) {
+            std::istringstream in( log.str() );
+            size_t n = 0;
+            for( wire::view token : wire::token_stream( in, " ,\n" ) ) n += token.size();
+            return n;
+        } );
+        bench( "std::getline( istream ), 1 MB", 10, []( size_t ) {
+            std::istringstream in( log.str() );
+            size_t n = 0;
+            for( std::string line; std::getline( in, line ); ) n += line.size();
+            return n;
+        } );
+        bench( "wire::token_stream( istream, lines ), 1 MB", 10, []( size_t ) {
+            std::istringstream in( log.str() );
+            size_t n = 0;
+            for( wire::view line : wire::token_stream( in, "\n", wire::token_stream::lines ) ) n += line.size();
+            return n;
+        } );
+        static const wire::string fields = std::string( 4000, 'a' ) + ";" + std::string( 4000, 'b' );
+        bench( "wire::string::tokenize_view( \";\" ), 2 long fields", N / 10, []( size_t ) {
+            size_t n = 0;
+            for( wire::view token : fields.tokenize_view( ";" ) ) n += token.size();
+            return n;
+        } );
+    }
+
+    /* stripping */ {
+        group = "stripping";
+        static const wire::string field = "   " + std::string( 24, 'v' ) + "  \r";
+        bench( "wire::string::strip()", N, []( size_t ) {
+            return field.strip().size();
+        } );
+        bench( "wire::string::strip_view()", N, []( size_t ) {
+            return field.strip_view().size();
+        } );
+        bench( "wire::string::strip( \"\\\" \" )", N, []( size_t ) {
+            return field.strip( "\" " ).size();
+        } );
+        bench( "wire::string::strip_view( \"\\\" \" )", N, []( size_t ) {
+            return field.strip_view( "\" " ).size();
+        } );
+        static wire::string reused;
+        bench( "wire::string::strip_inplace()", N, []( size_t ) {
+            reused = field;
+            return reused.strip_inplace().size();
+        } );
+    }
+
+    /* transformation chains */ {
+        group = "transformation chains";
+        // each named step copies, as every call did before the && overloads; the chained form moves one buffer along
+        static const wire::string header = "  Content-Type: Text/HTML; Charset=UTF-8  \r";
+        bench( "strip, lowercase, replace: named steps", N, []( size_t ) {
+            wire::string a = header.strip(), b = a.lowercase();
+            return b.replace( "-", "_" ).size();
+        } );
+        bench( "strip().lowercase().replace(): chained", N, []( size_t ) {
+            return header.strip().lowercase().replace( "-", "_" ).size();
+        } );
+        bench( "wire::string( header ).uppercase().str( \"<\", \">\" )", N, []( size_t ) {
+            return wire::string( header ).uppercase().str( "<", ">" ).size();
+        } );
+    }
+
+    /* appending and prepending */ {
+        group = "appending and prepending";
+        bench( "wire::string::push_back( int ) x 1000", N / 1000, []( size_t ) {
+            wire::string s;
+            for( int i = 0; i < 1000; ++i ) s.push_back( i );
+            return s.size();
+        } );
+        bench( "wire::string::push_front( int ) x 1000", N / 1000, []( size_t ) {
+            wire::string s;
+            for( int i = 0; i < 1000; ++i ) s.push_front( i );
+            return s.size();
+        } );
+        bench( "wire::deque_string::push_front( int ) x 1000", N / 1000, []( size_t ) {
+            wire::deque_string s;
+            for( int i = 0; i < 1000; ++i ) s.push_front( i );
+            return s.size();
+        } );
+        // framer: prepend a header to each 64-byte payload, then consume it from the front
+        static const std::string payload( 64, 'p' );
+        bench( "wire::string framing, 64 KB backlog", N / 10, []( size_t i ) {
+            static wire::string q = std::string( 1 << 16, 'q' );
+            q.push_back( payload );
+            q.push_front( int(i) );
+            q.erase( 0, payload.size() + wire::string( int(i) ).size() );
+            return q.size();
+        } );
+        bench( "wire::deque_string framing, 64 KB backlog", N / 10, []( size_t i ) {
+            static wire::deque_string q = std::string( 1 << 16, 'q' );
+            q.push_back( payload );
+            q.push_front( int(i) );
+            q.pop_front( payload.size() + wire::string( int(i) ).size() );
+            return q.size();
+        } );
+    }
+
+    /* string lists */ {
+        group = "string lists";
+        static std::vector< std::string > words;
+        for( size_t i = 0; i < 1000000; ++i )
+            words.push_back( wire::string( "field-\1", i * 7919 % 1000003 ) );
+        bench( "wire::strings, 1M short strings: build", 1, []( size_t ) {
+            wire::strings list;
+            for( const std::string &w : words ) list.push_back( w );
+            return list.size();
+        } );
+        bench( "wire::packed_strings, 1M short strings: build", 1, []( size_t ) {
+            wire::packed_strings list;
+            for( const std::string &w : words ) list.push_back( w );
+            return list.size();
+        } );
+        bench( "wire::packed_strings, 1M short strings: reserved", 1, []( size_t ) {
+            wire::packed_strings list;
+            list.reserve( words.size(), words.size() * 12 );
+            for( const std::string &w : words ) list.push_back( w );
+            return list.size();
+        } );
+        static const wire::strings deque_list( words );
+        static const wire::packed_strings packed_list( words );
+        bench( "wire::strings, 1M short strings: iterate", 10, []( size_t ) {
+            size_t n = 0;
+            for( const wire::string &s : deque_list ) n += s.size();
+            return n;
+        } );
+        bench( "wire::packed_strings, 1M short strings: iterate", 10, []( size_t ) {
+            size_t n = 0;
+            for( wire::view s : packed_list ) n += s.size();
+            return n;
+        } );
+        bench( "wire::strings::str(), 1M short strings", 1, []( size_t ) {
+            return deque_list.str().size();
+        } );
+        bench( "wire::packed_strings::str(), 1M short strings", 1, []( size_t ) {
+            return packed_list.str().size();
+        } );
+    }
+
+    /* interned keys */ {
+        group = "interned keys";
+        static std::vector< wire::string > names;
+        static std::vector< wire::atom > atoms;
+        static std::unordered_map< std::string, size_t > by_string;
+        static std::unordered_map< wire::atom, size_t > by_atom;
+        for( size_t i = 0; i < 3000; ++i ) {
+            names.push_back( wire::string( "request.header.field_\1", i ) );
+            atoms.push_back( wire::atom( names.back() ) );
+            by_string[ names.back() ] = i;
+            by_atom[ atoms.back() ] = i;
+        }
+        bench( "unordered_map< wire::string >::find, 3000 keys", N, []( size_t i ) {
+            return by_string.find( names[ i % 3000 ] )->second;
+        } );
+        bench( "unordered_map< wire::atom >::find, 3000 keys", N, []( size_t i ) {
+            return by_atom.find( atoms[ i % 3000 ] )->second;
+        } );
+        bench( "wire::string == wire::string", N, []( size_t i ) {
+            return size_t( names[ i % 3000 ] == names[ ( i * 7 ) % 3000 ] );
+        } );
+        bench( "wire::atom == wire::atom", N, []( size_t i ) {
+            return size_t( atoms[ i % 3000 ] == atoms[ ( i * 7 ) % 3000 ] );
+        } );
+        bench( "wire::atom( wire::string ), already interned", N, []( size_t i ) {
+            return wire::atom( names[ i % 3000 ] ).size();
+        } );
+    }
+
+    /* joiners */ {
+        group = "joiners";
+        static std::map< std::string, int > inventory;
+        for( int i = 0; i < 100000; ++i )
+            inventory[ wire::string( "item-\1", i ) ] = i;
+        static std::vector< double > prices( 100000, 19.99 );
+        bench( "wire::str12( map, \"\\1=\\2\\n\" ), 100k entries", 10, []( size_t ) {
+            return wire::str12( inventory, "\1=\2\n" ).size();
+        } );
+        bench( "wire::str( vector<double>, \"\\1,\" ), 100k entries", 10, []( size_t ) {
+            return wire::str( prices, "\1," ).size();
+        } );
+        static const wire::strings list( std::vector< std::string >( 100000, "some token" ) );
+        bench( "wire::strings::str(), 100k entries", 10, []( size_t ) {
+            return list.str().size();
+        } );
+
+        // streaming keeps a 4 KB chunk instead of the whole output
+        static FILE *null = std::fopen( "/dev/null", "wb" );
+        if( null ) {
+            bench( "wire::str12( sink( FILE* ), map ), 100k entries", 10, []( size_t ) {
+                wire::sink out( null );
+                wire::str12( out, inventory, "\1=\2\n" );
+                return size_t( 1 );
+            } );
+            bench( "std::fputs( wire::str12( map ) ), 100k entries", 10, []( size_t ) {
+                return size_t( std::fputs( wire::str12( inventory, "\1=\2\n" ).c_str(), null ) );
+            } );
+        }
+    }
+
+    /* memory-mapped files */ {
+        group = "memory-mapped files";
+        static const char *path = "bench.mapped.tmp";
+        static std::string chunk;
+        for( int i = 0; chunk.size() < ( 1 << 20 ); ++i )
+            chunk += wire::string( "2016-04-18 12:00:\1 worker-\2 GET /index.html?id=\3 200\n", i % 60, i % 8, i );
+        if( std::FILE *fp = std::fopen( path, "wb" ) ) {
+            for( int i = 0; i < 64; ++i ) std::fwrite( chunk.data(), 1, chunk.size(), fp );
+            std::fclose( fp );
+        }
+        size_t size = chunk.size() * 64;
+        bench( "std::fread into wire::string + count(), 64 MB", 4, []( size_t ) {
+            wire::string text;
+            if( std::FILE *fp = std::fopen( path, "rb" ) ) {
+                char buf[ 1 << 16 ];
+                for( size_t n; ( n = std::fread( buf, 1, sizeof(buf), fp ) ) > 0; ) text.append( buf, n );
+                std::fclose( fp );
+            }
+            return text.count( "GET " );
+        }, size );
+        bench( "wire::mapped_string::count(), 64 MB", 4, []( size_t ) {
+            return wire::mapped_string( path ).count( "GET " );
+        }, size );
+        static std::map< std::string, std::string > map;
+        map["GET "] = "POST "; map["worker-"] = "w"; map["index.html"] = "i";
+        static FILE *null = std::fopen( "/dev/null", "wb" );
+        if( null ) {
+            bench( "wire::string::replace_map() + fwrite, 64 MB", 2, []( size_t ) {
+                wire::mapped_string file( path );
+                std::string out = file.str().replace_map( map );
+                return std::fwrite( out.data(), 1, out.size(), null );
+            }, size );
+            bench( "wire::mapped_string::replace_map( sink ), 64 MB", 2, []( size_t ) {
+                wire::sink out( null );
+                wire::mapped_string( path ).replace_map( out, map );
+                return size_t( 1 );
+            }, size );
+        }
+        std::remove( path );
+    }
+
+    /* arena allocation */ {
+#ifdef __cpp_lib_memory_resource
+        group = "arena allocation";
+        // one request: split a header line, normalize every field, render a summary. The pmr run draws
+        // every string and list from a monotonic arena released per request instead of the heap
+        static const wire::string request = "GET /index.html?lang=en&theme=dark HTTP/1.1;Host: example.org;"
+            "Accept-Language: en-US,en;q=0.5;Connection: keep-alive;User-Agent: bench/1.0 (compatible)";
+        bench( "request: wire::string (default heap)", N / 10, []( size_t ) {
+            wire::strings fields( request.tokenize( ";" ) );
+            size_t n = 0;
+            for( wire::string &f : fields ) n += f.strip().lowercase().replace( ": ", "=" ).size();
+            wire::string line( "\1 fields, \2 bytes, last \3" );
+            line( fields.size(), n, fields.back() );
+            return line.size();
+        } );
+        static char storage[ 1 << 14 ];
+        static std::pmr::monotonic_buffer_resource arena( storage, sizeof( storage ) );
+        bench( "request: wire::pmr::string (monotonic arena)", N / 10, []( size_t ) {
+            size_t size;
+            {
+                wire::pmr::string text( request, &arena );
+                wire::pmr::strings fields( text.tokenize( ";" ) );
+                size_t n = 0;
+                for( wire::pmr::string &f : fields ) n += f.strip().lowercase().replace( ": ", "=" ).size();
+                wire::pmr::string line( "\1 fields, \2 bytes, last \3", &arena );
+                line( fields.size(), n, fields.back() );
+                size = line.size();
+            }
+            arena.release();
+            return size;
+        } );
+#endif
+    }
+
+    /* introspection */ {
+        group = "introspection";
+        static int health = 100;
+        static float money = 123.25f;
+        bench( "wire::parser( fmt, names )( values )", N / 10, []( size_t i ) {
+            return wire::parser( "\1=\2;", "health, money, i" )( health, money, i ).size();
+        } );
+        bench( "$wire( \"\\1=\\2;\", health, money, i )", N, []( size_t i ) {
+            return $wire( "\1=\2;", health, money, i ).size();
+        } );
+    }
+
+    /* api per input size */ {
+        // every public text api against a std:: baseline, over --sizes bytes of input (or list entries).
+        // Iterations shrink with the size so each case processes about the same number of bytes.
+        for( size_t size : sizes ) {
+            group = wire::string( "api per input size: \1", size );
+            size_t n = std::max< size_t >( N * 16 / std::max< size_t >( size, 16 ), 1 );
+            std::string label = wire::string( ", \1 bytes", size );
+
+            static std::string word, text, padded;
+            static wire::string wtext, wpadded;
+            static std::vector< int > numbers;
+            static std::map< std::string, std::string > map;
+            word.assign( size, 'w' );
+            text.clear();
+            for( size_t i = 0; text.size() < size; ++i )
+                text += wire::string( i % 5 ? "key-\1," : "$a$;", i );
+            text.resize( size );
+            padded = "  \t" + text + " \r\n";
+            wtext = text, wpadded = padded;
+            numbers.assign( size, 42 );
+            map.clear();
+            map["$a$"] = "alpha"; map["key"] = "k"; map[","] = ", "; map[";"] = "";
+
+            bench( "std::ostringstream << text << '=' << int" + label, n, []( size_t i ) {
+                std::ostringstream ss;
+                ss << word << '=' << int(i) << ';';
+                return ss.str().size();
+            }, size );
+            bench( "wire::string( \"\\1=\\2;\", text, int )" + label, n, []( size_t i ) {
+                return wire::string( "\1=\2;", word, int(i) ).size();
+            }, size );
+            bench( "std::snprintf( \"%s=%d;\" )" + label, n, []( size_t i ) {
+                std::string out( word.size() + 16, '\0' );
+                out.resize( std::snprintf( &out[0], out.size(), "%s=%d;", word.c_str(), int(i) ) );
+                return out.size();
+            }, size );
+            bench( "wire::format( \"%s=%d;\" )" + label, n, []( size_t i ) {
+                return wire::format( "%s=%d;", word.c_str(), int(i) ).size();
+            }, size );
+            bench( "std::string::find( \"$a$;k\" ) != npos" + label, n, []( size_t ) {
+                return size_t( text.find( "$a$;k" ) != std::string::npos );
+            }, size );
+            bench( "wire::string::matches( \"*$a$;k*\" )" + label, n, []( size_t ) {
+                return size_t( wtext.matches( "*$a$;k*" ) );
+            }, size );
+            bench( "std::string find/replace per key, 4 keys" + label, n, []( size_t ) {
+                std::string out = text;
+                for( auto it = map.rbegin(); it != map.rend(); ++it )
+                    for( size_t pos = 0; ( pos = out.find( it->first, pos ) ) != std::string::npos; pos += it->second.size() )
+                        out.replace( pos, it->first.size(), it->second );
+                return out.size();
+            }, size );
+            bench( "wire::string::replace_map( 4 keys )" + label, n, []( size_t ) {
+                return wtext.replace_map( map ).size();
+            }, size );
+            bench( "std::string::find_first_of tokenize" + label, n, []( size_t ) {
+                std::vector< std::string > out;
+                for( size_t pos = 0, end; pos < text.size(); pos = end + 1 ) {
+                    end = text.find_first_of( ",;", pos );
+                    if( end == std::string::npos ) end = text.size();
+                    if( end > pos ) out.push_back( text.substr( pos, end - pos ) );
+                }
+                return out.size();
+            }, size );
+            bench( "wire::string::tokenize( \",;\" )" + label, n, []( size_t ) {
+                return wtext.tokenize( ",;" ).size();
+            }, size );
+            bench( "wire::string::tokenize_view( \",;\" )" + label, n, []( size_t ) {
+                size_t k = 0;
+                for( wire::view token : wtext.tokenize_view( ",;" ) ) k += token.size();
+                return k;
+            }, size );
+            bench( "std::string::find_first_of split" + label, n, []( size_t ) {
+                std::vector< std::string > out;
+                for( size_t pos = 0, end; pos < text.size(); pos = end + 1 ) {
+                    end = text.find_first_of( ",;", pos );
+                    if( end == std::string::npos ) end = text.size();
+                    if( end > pos ) out.push_back( text.substr( pos, end - pos ) );
+                    if( end < text.size() ) out.push_back( text.substr( end, 1 ) );
+                }
+                return out.size();
+            }, size );
+            bench( "wire::string::split( \",;\" )" + label, n, []( size_t ) {
+                return wtext.split( ",;" ).size();
+            }, size );
+            bench( "std::string::find_first_not_of strip" + label, n, []( size_t ) {
+                size_t l = padded.find_first_not_of( " \t\r\n" ), r = padded.find_last_not_of( " \t\r\n" );
+                return l == std::string::npos ? 0 : padded.substr( l, r - l + 1 ).size();
+            }, size );
+            bench( "wire::string::strip()" + label, n, []( size_t ) {
+                return wpadded.strip().size();
+            }, size );
+            bench( "std::ostringstream join, entries" + label, n, []( size_t ) {
+                std::ostringstream ss;
+                for( int v : numbers ) ss << v << ',';
+                return ss.str().size();
+            }, size );
+            bench( "wire::str( vector<int>, \"\\1,\" ), entries" + label, n, []( size_t ) {
+                return wire::str( numbers, "\1," ).size();
+            }, size );
+        }
+    }
+
+    /* fixed-size apis */ {
+        group = "fixed-size apis";
+        static int health = 100;
+        static float money = 123.25f;
+        bench( "std::ostringstream << \"health=\" << health << ...", N, []( size_t i ) {
+            std::ostringstream ss;
+            ss << "health=" << health << ",money=" << money << ",i=" << i << ',';
+            return ss.str().size();
+        } );
+        bench( "$wire( \"\\1=\\2,\", health, money, i )", N, []( size_t i ) {
+            return $wire( "\1=\2,", health, money, i ).size();
+        } );
+        static const wire::string numbers[] = { "123", "-456789", "2147483647", "0" };
+        bench( "std::stoi()", N, []( size_t i ) {
+            return size_t( std::stoi( numbers[ i & 3 ] ) );
+        } );
+        bench( "wire::string::as<int>()", N, []( size_t i ) {
+            return size_t( numbers[ i & 3 ].as<int>() );
+        } );
+    }
+
+    if( json )
+        print_json( N );
+    if( wire::stats::enabled )
+        wire::stats::dump( std::cerr );
+    return 0;
+}
@@ -1,10 +1,37 @@
+#include <atomic>
 #include <cassert>
 #include <cmath>
+#include <cstdlib>
 
 #include <iostream>
+#include <new>
+#include <thread>
 
+#define WIRE_FD
+#define WIRE_MMAP
 #include "wire.hpp"
 
+// global heap allocations, to check code paths that must only use a given allocator
+// (kept out of line, as inlined pairs trip gcc's new/delete mismatch warning)
+#if defined(__GNUC__)
+#   define ctest$noinline __attribute__((noinline))
+#else
+#   define ctest$noinline
+#endif
+static std::atomic< size_t > ctest_allocations( 0 );
+
+ctest$noinline void *operator new( size_t n ) {
+    ++ctest_allocations;
+    if( void *ptr = std::malloc( n ? n : 1 ) ) return ptr;
+    throw std::bad_alloc();
+}
+ctest$noinline void operator delete( void *ptr ) noexcept {
+    std::free( ptr );
+}
+ctest$noinline void operator delete( void *ptr, size_t ) noexcept {
+    std::free( ptr );
+}
+
 std::stringstream right, wrong;
 
 #define test1(A) [&]() { auto _A_ = (A); if( _A_ != decltype(A)(0) ) \
@@ -41,6 +68,28 @@ struct ctest_stream2
     {}
 };
 
+// formats a wire::string of its own while an outer format is rendering it
+struct ctest_nested
+{
+    int value;
+    friend std::ostream &operator<<( std::ostream &os, const ctest_nested &self )
+    {
+        wire::string inner( "<\1>" );
+        return os << inner( self.value );
+    }
+};
+
+// streams "T<n>", or fails (and renders empty) when n is 0
+struct ctest_failing
+{
+    int n;
+    friend std::ostream &operator<<( std::ostream &os, const ctest_failing &self )
+    {
+        if( !self.n ) os.setstate( std::ios::failbit );
+        return os << "T" << self.n;
+    }
+};
+
 void tests_from_string_sample()
 {
     /* many constructors */ {
@@ -77,6 +126,32 @@ void tests_from_string_sample()
     test3( arg2 ,==, "hello true world" );
     test3( arg3 ,==, "hello {world}" );
     test3( arg4 ,==, "hello world 3.14159 3.14159 false \x1 hello {world} 0" );
+
+    wire::string arg12( "\1\2\3\4\5\6\7\10\11\12\13\14", 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 );
+    wire::string arg31( "\1\37", 'a',0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, 'z' );
+    wire::string tabs( "\1\t\2\n", "key", "value" );
+
+    test3( arg12 ,==, "123456789101112" );
+    test3( arg31 ,==, "az" );
+    test3( tabs ,==, "key\tvalue\n" );
+    }
+
+    /* reusable operator() */ {
+    wire::string line;
+    for( int i = 0; i < 3; ++i ) {
+        line = "\1: \2";
+        line( i, line.size() );
+    }
+    test3( line ,==, "2: 4" );
+    test3( wire::string("\1\2\3")("hello", "world", 12) ,==, "helloworld12" );
+    wire::string nested( "a=\1 b=\2" );
+    test3( nested( ctest_nested{ 1 }, 2 ) ,==, "a=<1> b=2" );
+    wire::string big( "\1" );
+    big( std::string( 1 << 20, 'x' ) );
+    big = "\1";
+    big( "y" );
+    test3( big ,==, "y" );
+    test1( wire::scratch().text.capacity() <= wire::scratch_buffer::keep_limit );
     }
 
     /* chaining */ {
@@ -128,6 +203,35 @@ void tests_from_string_sample()
     hi.push_back(hi);  // hi = "Hi?404!Hi?404!"
 
     test3( hi ,==, "Hi?404!Hi?404!" );
+
+    hi.push_front(1.5f);  // hi = "1.5Hi?404!Hi?404!"
+    hi.push_front(hi);    // hi = "1.5Hi?404!Hi?404!1.5Hi?404!Hi?404!"
+    test3( hi ,==, "1.5Hi?404!Hi?404!1.5Hi?404!Hi?404!" );
+    }
+
+    /* double-ended strings */ {
+    wire::deque_string frame;
+    frame.push_back( "payload" );
+    frame.push_front( ':' ).push_front( 7 );
+    frame << '\n';
+    test3( frame.str(), ==, "7:payload\n" );
+    frame.pop_front( 2 );
+    frame.pop_back();
+    test3( frame.str(), ==, "payload" );
+    for( int i = 0; i < 1000; ++i ) frame.push_front( 'x' ), frame.push_back( 'y' ), frame.pop_front();
+    test3( frame.size(), ==, 1007 );
+    test3( frame.front(), ==, 'p' );
+    test3( frame.back(), ==, 'y' );
+    frame.pop_front( 5000 );
+    test1( frame.empty() );
+    const wire::deque_string &readonly = frame;
+    test3( frame.front(), ==, '\0' );
+    test3( frame.back(), ==, '\0' );
+    test3( readonly.front(), ==, '\0' );
+    test3( readonly.back(), ==, '\0' );
+    test3( wire::deque_string( "ab" ).back(), ==, 'b' );
+    frame.push_front( wire::string("abc") ).push_front( wire::view( frame ) );
+    test3( std::string( frame ), ==, "abcabc" );
     }
 
     /* quick introspection echo macro */ {
@@ -139,6 +243,13 @@ void tests_from_string_sample()
     test3( echo, ==, "health=100;money=123.25;hello=world!;" );
 
     test3( std::string(), ==, $wire("", 0) );
+
+    struct { int hp; } player = { 7 }, *self = &player;
+    test3( $wire("\1:\2 ", player.hp, self->hp), ==, "hp:7 >hp:7 " );
+    test3( $wire("\1=\2,\3|", health, money), ==, "health=100,\3|money=123.25,\3|" );
+    test3( $wire("\1=\2", health).uppercase(), ==, "HEALTH=100" );
+    for( int i = 0; i < 3; ++i )
+        test3( $wire("\2", i), ==, wire::string( i ) );
     }
 }
 
@@ -146,8 +257,40 @@ int main( int argc, const char **argv )
 {
     // tools
     test3( wire::format("%d %1.3f %s", 10, 3.14159f, "hello world"), ==, "10 3.142 hello world" );
+    test3( wire::format("%s", std::string(1000, 'x').c_str()), ==, std::string(1000, 'x') );
+    test3( wire::format(""), ==, "" );
+
+    /* formatting into existing strings */ {
+    std::string stats( "stale" );
+    test3( wire::format_to( stats, "%d/%d", 1, 2 ), ==, "1/2" );
+    test3( wire::format_append( stats, " %s", "ok" ), ==, "1/2 ok" );
+    test3( wire::format_append( stats, "%600d", 3 ).size(), ==, 606 );
+    }
+
+    /* precompiled safe formats */ {
+    wire::fmt kv( "\1=\2;" ), all( "hello \1 \2 \3 \4 \5 \6 \7" ), swapped( "\2\n\1\x1f" );
+
+    test3( kv( "health", 100 ), ==, "health=100;" );
+    test3( kv( "money", 123.25f ), ==, wire::string( "\1=\2;", "money", 123.25f ) );
+    test3( kv( "missing" ), ==, "missing=\2;" );
+    test3( all( "world", 3.14159f, 3.14159L, false, '\x1', wire::string("x"), 0 ), ==,
+          wire::string( "hello \1 \2 \3 \4 \5 \6 \7", "world", 3.14159f, 3.14159L, false, '\x1', wire::string("x"), 0 ) );
+    test3( swapped( -1, (unsigned char)('}') ), ==, "}\n-1\x1f" );
+
+    std::string out( "reused" );
+    test3( kv.to( out, "a", 'b' ), ==, "a=b;" );
+    test3( kv.append( out, "c", true ), ==, "a=b;c=true;" );
+    }
 
     test3( wire::string(99.95f), ==, "99.95" );
+    test3( wire::string(0.0001), ==, "0.0001" );
+    test3( wire::string(0.00001), ==, "1e-05" );
+    test3( wire::string(123456.5), ==, "123456" );
+    test3( wire::string(999999.5), ==, "1e+06" );
+    test3( wire::string(-0.0), ==, "-0" );
+    test3( wire::string(-2147483647 - 1), ==, "-2147483648" );
+    test3( wire::string(18446744073709551615ull), ==, "18446744073709551615" );
+    test3( wire::string() << 3 << -1 << 0.5f, ==, "3-10.5" );
     test3( wire::string(999.9999), ==, 999.9999 );
     test3( wire::precise(999.9999f), ==, "0x1.f3fffcp+9" );
     test3( wire::precise("0x1.f3fffcp+9"), ==, 999.9999 );
@@ -180,6 +323,17 @@ int main( int argc, const char **argv )
     test3( wire::string(" a b c").rstrip(), ==, " a b c" );
     test3( wire::string("a b c ").rstrip(), ==, "a b c" );
     test3( wire::string(" a b c ").rstrip(), ==, " a b c" );
+    test3( wire::string("  \t\n").rstrip(), ==, "" );
+    test3( wire::string("xxabcxx").rstrip("x"), ==, "xxabc" );
+    test3( wire::string("xxxx").rstrip("x"), ==, "" );
+
+    wire::string padded = "\t  " + std::string( 20, 'a' ) + " b" + std::string( 18, ' ' ) + "\r\n";
+    test1( padded.strip_view() == std::string( 20, 'a' ) + " b" );
+    test1( padded.lstrip_view().size() == padded.size() - 3 );
+    test1( padded.rstrip_view().data() == padded.data() );
+    test1( wire::string("-=hello=-").strip_view("=-") == "hello" );
+    test3( padded.strip_inplace(), ==, std::string( 20, 'a' ) + " b" );
+    test3( wire::string("--x--").lstrip_inplace("-").rstrip_inplace("-"), ==, "x" );
 
     //ptr to method
     if( 1 )
@@ -311,6 +465,69 @@ int main( int argc, const char **argv )
     test3( wire::string(  "true" ).as<double>(), ==, 1.f );
     test3( wire::string(     3.0 ).as<double>(), ==, 3.0 );
 
+    test3( wire::string( "  -456.123xyz" ).as<int>(), ==, -456 );
+    test3( wire::string( "99999999999" ).as<int>(), ==, 1 );
+    test3( wire::string( "1.5e3" ).as<double>(), ==, 1500.0 );
+    test3( wire::string( "1e" ).as<double>(), ==, 1.0 );
+    test3( wire::string( "0.1" ).as<float>(), ==, 0.1f );
+
+    int parsed = 7;
+    test1( !wire::string( "true" ).try_as( parsed ) );
+    test1( !wire::string( "12abc" ).try_as( parsed ) );
+    test1( !wire::string( "99999999999" ).try_as( parsed ) );
+    test3( parsed, ==, 7 );
+    test1( wire::string( " -12 " ).try_as( parsed ) );
+    test3( parsed, ==, -12 );
+    bool flag = false;
+    test1( wire::string( "true" ).try_as( flag ) );
+    test3( flag, ==, true );
+    double real = 0;
+    test1( wire::string( "3.25" ).try_as( real ) && real == 3.25 );
+    test1( !wire::string( "" ).try_as( real ) );
+
+    /* wildcards */ {
+    test1( wire::string("hello.txt").matches("h*.t?t") );
+    test1( !wire::string("hello.txt").matches("hello?txt") );
+    test1( wire::string("HeLLo").matchesi("hel*") );
+    test1( !wire::string( std::string(64, 'a') ).matches("*a*a*a*a*a*a*a*a*a*a*a*a*b") );
+
+    wire::glob logs( "*.LOG", true ), any( "**" );
+    wire::strings files( "a.log", "b.txt", "c.Log" );
+    test3( logs.count( files ), ==, 2 );
+    test3( logs.filter( files ).str("\1;"), ==, "a.log;c.Log;" );
+    test1( any( "" ) );
+    test1( wire::glob( "ab?d" )( "abcd" ) );
+    }
+
+    /* multi-pattern replacement */ {
+    std::map< std::string, std::string > map;
+    map["a"] = "1"; map["ab"] = "2"; map["abc"] = "3"; map["bc"] = "4";
+    test3( wire::string("abcabxabca").replace_map( map ), ==, "32x31" );
+    test3( wire::string("xyz").replace_map( map ), ==, "xyz" );
+
+    std::map< std::string, std::string > bytes;
+    bytes["<"] = "&lt;"; bytes[">"] = "&gt;"; bytes["&"] = "&amp;";
+    wire::replacer escape( bytes );
+    test3( wire::string("<a & b>").replace_map( escape ), ==, "&lt;a &amp; b&gt;" );
+    test3( escape( "no tags" ), ==, "no tags" );
+
+    test3( wire::string("a-b_c").replace_map( "-_", "  " ), ==, "a b c" );
+
+    // inputs spanning several 64 KB scan windows, with keys across window boundaries
+    std::string large, expected;
+    unsigned seed = 7;
+    while( large.size() < 300000 ) {
+        seed = seed * 1103515245u + 12345u;
+        large += "abcx"[ ( seed >> 16 ) % 4 ];
+    }
+    for( size_t i = 0; i < large.size(); ) {
+        size_t m = large.compare( i, 3, "abc" ) == 0 ? 3 : large.compare( i, 2, "ab" ) == 0 || large.compare( i, 2, "bc" ) == 0 ? 2 : large[i] == 'a' ? 1 : 0;
+        expected += m ? map[ large.substr( i, m ) ] : large.substr( i, 1 );
+        i += m ? m : 1;
+    }
+    test1( wire::string( large ).replace_map( map ) == expected );
+    }
+
     //del replacement
     test3( wire::string("%25hello%25%25world%25").replace("%25",""), ==, "helloworld" );
     //same replacement
@@ -320,6 +537,94 @@ int main( int argc, const char **argv )
     //shorter replacement
     test3( wire::string("%25hello%25%25world%25").replace("%25","%2"), ==, "%2hello%2%2world%2" );
 
+    test3( wire::string("aaaa").count("aa"), ==, 2 );
+    test3( wire::string("abc").count(""), ==, 0 );
+    test3( wire::string("abc").replace("", "x"), ==, "abc" );
+    test3( wire::string( std::string(100, 'a') + "needle" + std::string(100, 'a') ).left_of("needle"), ==, std::string(100, 'a') );
+    test3( wire::string("mammy").replace("m", "d"), ==, "daddy" );
+    test3( wire::string("mammy").replace1("m", "d"), ==, "dammy" );
+    test3( wire::string("mammy").replace1("", "d"), ==, "dmammy" );
+    test3( wire::string().replace1("", "d"), ==, "d" );
+
+    /* case conversion and case-insensitive comparisons */ {
+    wire::string mixed = "Hello, World! 0123456789 [abc_xyz] `~{}";
+    test3( mixed.uppercase(), ==, "HELLO, WORLD! 0123456789 [ABC_XYZ] `~{}" );
+    test3( mixed.lowercase(), ==, "hello, world! 0123456789 [abc_xyz] `~{}" );
+    test3( wire::string("abc\xe9" "def").uppercase(), ==, "ABC\xe9" "DEF" );
+    test1( mixed.equalsi( "hello, WORLD! 0123456789 [ABC_xyz] `~{}" ) );
+    test1( !mixed.equalsi( "hello, world" ) );
+    test1( !wire::string("@").equalsi( "`" ) );
+    test3( wire::string("apple").comparei( "APPLE" ), ==, 0 );
+    test3( wire::string("apple").comparei( "Banana" ), <, 0 );
+    test3( wire::string("apple").comparei( "APP" ), >, 0 );
+    test1( wire::string("Content-Length").starts_withi( "content-" ) );
+    test1( wire::string("archive.TAR.GZ").ends_withi( ".tar.gz" ) );
+    test1( !wire::string("gz").ends_withi( ".tar.gz" ) );
+    test1( !wire::string("Hello").starts_with( "he" ) );
+    }
+
+    /* rvalue transformations */ {
+    wire::string header = "  Content-Type: Text/HTML  ";
+    test3( header.strip().lowercase().replace( "-", "_" ), ==, "content_type: text/html" );
+    test3( header, ==, "  Content-Type: Text/HTML  " );
+    test3( wire::string( header ).uppercase(), ==, "  CONTENT-TYPE: TEXT/HTML  " );
+    test3( wire::string( "xaxbx" ).replace( "x", "" ), ==, "ab" );
+    test3( wire::string( "aaaa" ).replace( "aa", "b" ), ==, "bb" );
+    test3( wire::string( "abc" ).replace( "b", "[b]" ), ==, "a[b]c" );
+    test3( wire::string( "abc" ).replace( "", "x" ), ==, "abc" );
+    test3( wire::string( "..ab.." ).lstrip( "." ), ==, "ab.." );
+    test3( wire::string( "..ab.." ).rtrim( "." ), ==, "..ab" );
+    test3( wire::string( "mid" ).str( "<", ">" ), ==, "<mid>" );
+    wire::string self = "abab";
+    test3( std::move( self ).replace( self.substr( 0, 1 ), "" ), ==, "bb" );
+    wire::string from = "  " + std::string( 40, 'b' ) + "  ";
+    const char *data = from.data();
+    wire::string to = std::move( from ).strip().uppercase().replace( "BB", "c" );
+    test3( to.data(), ==, data );
+    test3( to, ==, std::string( 20, 'c' ) );
+    }
+
+    /* tokenizing */ {
+    wire::string csv = ",,alpha;beta,,gamma;";
+    wire::strings fields = csv.tokenize(",;");
+    test3( fields.size(), ==, 3 );
+    test3( fields.str("\1|"), ==, "alpha|beta|gamma|" );
+    test3( wire::string(",;,").tokenize(",;").size(), ==, 0 );
+    test3( wire::string("whole").tokenize("").size(), ==, 1 );
+
+    std::string joined;
+    for( wire::view field : csv.tokenize_view(",;") )
+        joined += field.str() + "|";
+    test3( joined, ==, "alpha|beta|gamma|" );
+
+    wire::string line = std::string( 40, 'x' ) + " " + std::string( 40, 'y' ) + "\t" + std::string( 3, 'z' );
+    wire::tokenizer words = line.tokenize_view(" \t");
+    wire::view word;
+    test1( words.next( word ) && word == std::string( 40, 'x' ) );
+    test1( words.next( word ) && word == std::string( 40, 'y' ) );
+    test1( words.next( word ) && word == "zzz" );
+    test1( !words.next( word ) );
+    test3( wire::string( "[\1]", word ), ==, "[zzz]" );
+
+    wire::string call = "f(a, b);";
+    test3( call.split(" ,;()").size(), ==, 8 );
+    test3( wire::strings( call.split(" ,;()") ).str("\1|"), ==, "f|(|a|,| |b|)|;|" );
+    test3( wire::string("a__b").split("_").size(), ==, 4 );
+
+    joined.clear();
+    for( wire::view piece : call.split_view(" ,;()") )
+        joined += piece.str() + "|";
+    test3( joined, ==, "f|(|a|,| |b|)|;|" );
+
+    wire::string assignment = "x=1;y";
+    wire::splitter pairs = assignment.split_view("=;");
+    wire::view token, separator;
+    test1( pairs.next( token, separator ) && token == "x" && separator == "=" );
+    test1( pairs.next( token, separator ) && token == "1" && separator == ";" );
+    test1( pairs.next( token, separator ) && token == "y" && separator.empty() );
+    test1( !pairs.next( token, separator ) );
+    }
+
     test3( wire::string().size(), ==, 0 );
     test3( wire::string("").size(), ==, 0 );
     test3( wire::string(), ==, "" );
@@ -355,6 +660,295 @@ int main( int argc, const char **argv )
     test3( wire::string().at( 0), ==, '\0' );
     test3( wire::string().at( 1), ==, '\0' );
 
+    /* packed string lists */ {
+    wire::packed_strings packed;
+    packed.push_back( "alpha" );
+    packed.push_back( 42 );
+    packed.push_back( wire::string("gamma") );
+    packed.push_back( packed[0] );
+    test3( packed.size(), ==, 4 );
+    test3( packed.bytes(), ==, 17 );
+    test1( packed[1] == "42" );
+    test1( packed.at( -1 ) == "alpha" );
+    test1( packed.at( 5 ) == "42" );
+    test3( packed.str( "<\1>", "[", "]" ), ==, "[<alpha><42><gamma><alpha>]" );
+    test3( packed.str(), ==, wire::strings( std::vector< std::string >( packed ) ).str() );
+    packed.pop_back();
+    test3( packed.bytes(), ==, 12 );
+    wire::strings unpacked = wire::strings( packed );
+    test3( unpacked.size(), ==, 3 );
+    test3( unpacked[2], ==, "gamma" );
+    test1( wire::packed_strings( unpacked ).back() == "gamma" );
+    test1( wire::packed_strings().at( 3 ).empty() );
+    }
+
+    /* interned strings */ {
+    wire::atom hello( "hello" ), hello2( wire::string("hel") + "lo" ), yes( true ), empty;
+    test1( hello == hello2 );
+    test1( hello.data() == hello2.data() );
+    test1( hello != yes );
+    test1( yes == wire::atom( "true" ) );
+    test1( empty.empty() && empty == wire::atom( "" ) );
+    test3( hello.hash(), ==, std::hash< wire::atom >()( hello2 ) );
+    test3( wire::string( hello ), ==, "hello" );
+    test3( wire::string( "\1=\2", hello, yes ), ==, "hello=true" );
+    test1( wire::atom( "apple" ) < wire::atom( "banana" ) );
+    test1( wire::view( hello ) == "hello" );
+    }
+
+    /* joiners */ {
+    std::map< std::string, int > inventory;
+    inventory["apples"] = 3; inventory["pears"] = 10;
+    test3( wire::str12( inventory, "\1=\2;", "{", "}" ), ==, "{apples=3;pears=10;}" );
+    test3( wire::str1( inventory, "\1 " ), ==, "apples pears " );
+    test3( wire::str2( inventory, "[\1]" ), ==, "[3][10]" );
+    std::vector< float > reals( 3, 0.5f );
+    test3( wire::str( reals, "\1\2", "(", ")" ), ==, "(0.5\2" "0.5\2" "0.5\2)" );
+    test3( wire::strings( "x", "y" ).str( "\1," ), ==, "x,y," );
+    std::vector< ctest_failing > failing = { { 1 }, { 0 }, { 2 } };
+    test3( wire::str( failing, "\1," ), ==, "T1,,T2," );
+    test3( wire::string( ctest_failing{ 0 } ), ==, "" );
+    test3( wire::strings( std::vector< std::string >( 1, "x" ) ).str( "\1,", "<", ">" ), ==, "<x>" );
+    }
+
+    /* sinks */ {
+    std::string text;
+    {
+        wire::sink out( text );
+        wire::format( out, "%d-%s;", 7, "up" );
+        wire::fmt( "\1=\2;" ).to( out, "k", 1.5f );
+        wire::strings( "a", "b" ).str( out, "<\1>" );
+    }
+    test3( text, ==, "7-up;k=1.5;<a><b>" );
+
+    std::stringstream ss;
+    std::map< int, std::string > big;
+    for( int i = 0; i < 2000; ++i ) big[ i ] = "value";
+    {
+        wire::sink out( ss );
+        wire::str12( out, big, "\1:\2\n", "begin\n", "end\n" );
+    }
+    test3( ss.str(), ==, wire::str12( big, "\1:\2\n", "begin\n", "end\n" ) );
+
+    size_t chunks = 0, bytes = 0;
+    {
+        wire::sink out( std::function< void( const char *, size_t ) >( [&]( const char *, size_t n ) { ++chunks, bytes += n; } ) );
+        wire::str1( out, big, "\1," );
+        test3( chunks, >, 0 );
+    }
+    test3( bytes, ==, wire::str1( big, "\1," ).size() );
+
+    std::stringstream streamed;
+    streamed << wire::strings( "x", "y" );
+    test3( streamed.str(), ==, "x\ny\n" );
+
+    int health = 100;
+    std::string echo;
+    {
+        wire::sink out( echo );
+        $wire_to( out, "\1=\2;", health );
+    }
+    test3( echo, ==, "health=100;" );
+    }
+
+    /* empty at() sentinels */ {
+    wire::string none;
+    none.at( 3 ) = 'x';
+    test3( none.at( 3 ), ==, '\0' );
+    test3( none.size(), ==, 0 );
+    wire::strings nothing;
+    nothing.at( -1 ) = "garbage";
+    test3( nothing.at( 0 ), ==, "" );
+    test3( nothing.size(), ==, 0 );
+    const wire::strings cnothing;
+    test3( cnothing[ 7 ], ==, "" );
+    test3( wire::strings( "a", "b", "c" ).at( -4 ), ==, "c" );
+    test3( wire::strings( "a", "b", "c" ).at( 4 ), ==, "b" );
+    }
+
+    /* memory-mapped files */ {
+    std::string text;
+    for( int i = 0; text.size() < 200000; ++i )
+        text += wire::string( "line \1: GET /index.html?id=\2 ab abc\n", i, i * 7 );
+    const char *path = "wire.mapped.tmp";
+    if( std::FILE *fp = std::fopen( path, "wb" ) ) std::fwrite( text.data(), 1, text.size(), fp ), std::fclose( fp );
+
+    wire::mapped_string file( path );
+    const wire::string copy = text;
+    test1( file.good() );
+    test3( file.size(), ==, text.size() );
+    test3( file.count( "GET " ), ==, copy.count( "GET " ) );
+    test3( file.find( "id=7" ), ==, text.find( "id=7" ) );
+    test3( file.find( "missing" ), ==, std::string::npos );
+    test1( file.matches( "line 0:*abc\n" ) );
+    test1( file.starts_withi( "LINE 0" ) );
+    test1( file.ends_with( "abc\n" ) );
+    test3( file.at( -1 ), ==, '\n' );
+    test3( file.at( -1 ), ==, file.data()[ file.size() - 1 ] );
+    test3( file.at( -int( file.size() ) ), ==, file.data()[0] );
+    test3( file.at( file.size() + 1 ), ==, file.data()[1] );
+    // the wrap-around math holds past INT_MAX, for mappings over 2 GB
+    const size_t huge = ( size_t(3) << 30 ) + 5;
+    test1( wire::wrap_index( -1LL, huge ) == huge - 1 && wire::wrap_index( (long long)huge + 2, huge ) == 2 );
+    test1( file.tokenize( " :\n" ) == copy.tokenize( " :\n" ) );
+    test1( file.split( " :\n" ) == copy.split( " :\n" ) );
+    test1( file.replace( "GET", "POST" ) == copy.replace( "GET", "POST" ) );
+
+    std::map< std::string, std::string > keys, bytes;
+    keys["ab"] = "[ab]"; keys["abc"] = "<abc>"; keys["GET /"] = ""; keys["\n"] = "\r\n";
+    bytes["a"] = "A"; bytes["\n"] = "";
+    std::string streamed, replaced;
+    {
+        wire::sink out( streamed );
+        file.replace_map( out, keys ).append( "|" );
+        file.replace( out, "GET", "POST" );
+    }
+    test1( streamed == copy.replace_map( keys ) + "|" + copy.replace( "GET", "POST" ) );
+    {
+        wire::sink out( replaced );
+        file.replace_map( out, bytes );
+    }
+    test1( replaced == copy.replace_map( bytes ) );
+
+    wire::mapped_string moved( std::move( file ) );
+    test3( moved.size(), ==, text.size() );
+    test3( file.size(), ==, 0 );
+    test1( !file.good() );
+    std::remove( path );
+
+    if( std::FILE *fp = std::fopen( path, "wb" ) ) std::fclose( fp );
+    wire::mapped_string nothing( path );
+    test1( nothing.good() && nothing.empty() && !nothing.is_mapped() );
+    test3( nothing.at( 3 ), ==, '\0' );
+    std::remove( path );
+    test1( !wire::mapped_string( path ).good() );
+    }
+
+    /* streaming tokenizers */ {
+    const wire::string input = ",,alpha;beta,,gamma;\n\ndelta-epsilon,zeta\r\n;;" + std::string( 300, 'x' ) + ";eta,\nlast";
+    std::deque< std::string > lines;
+    {
+        std::istringstream ss( input.str() );
+        for( std::string line; std::getline( ss, line ); ) lines.push_back( line );
+    }
+    bool all_tokens = true, all_pieces = true, all_lines = true;
+    unsigned seed = 12345;
+    for( int round = 0; round < 200; ++round ) {
+        seed = seed * 1103515245u + 12345u;
+        size_t chunk = 1 + ( seed >> 8 ) % 64;
+        std::istringstream a( input.str() ), b( input.str() ), c( input.str() );
+        std::deque< std::string > tokens, pieces, rows;
+        for( wire::view v : wire::token_stream( a, ",;\n", wire::token_stream::tokenize, chunk ) ) tokens.push_back( v );
+        for( wire::view v : wire::token_stream( b, ",;\n", wire::token_stream::split, chunk ) ) pieces.push_back( v );
+        for( wire::view v : wire::token_stream( c, "\n", wire::token_stream::lines, chunk ) ) rows.push_back( v );
+        all_tokens &= wire::strings( input.tokenize( ",;\n" ) ) == wire::strings( tokens );
+        all_pieces &= wire::strings( input.split( ",;\n" ) ) == wire::strings( pieces );
+        all_lines &= rows == lines;
+    }
+    test1( all_tokens );
+    test1( all_pieces );
+    test1( all_lines );
+
+    const char *path = "wire.stream.tmp";
+    if( std::FILE *fp = std::fopen( path, "wb" ) ) std::fwrite( input.data(), 1, input.size(), fp ), std::fclose( fp );
+    if( std::FILE *fp = std::fopen( path, "rb" ) ) {
+        wire::token_stream stream( fileno( fp ), ",;\n", wire::token_stream::tokenize, 7 );
+        std::deque< std::string > tokens;
+        for( wire::view v; stream.next( v ); ) tokens.push_back( v );
+        test1( wire::strings( input.tokenize( ",;\n" ) ) == wire::strings( tokens ) );
+        std::fclose( fp );
+    }
+    std::remove( path );
+
+    // a token and a line far longer than the chunk are carried across many refills
+    const std::string huge( 1 << 20, 'y' );
+    std::istringstream long_tokens( "a," + huge + ",b" ), long_lines( "a\n" + huge + "\nb" );
+    std::deque< std::string > pieces, rows;
+    for( wire::view v : wire::token_stream( long_tokens, ",", wire::token_stream::tokenize, 1000 ) ) pieces.push_back( v );
+    for( wire::view v : wire::token_stream( long_lines, "\n", wire::token_stream::lines, 1000 ) ) rows.push_back( v );
+    test3( pieces.size(), ==, 3 );
+    test1( pieces.size() == 3 && pieces[1] == huge && pieces[2] == "b" );
+    test1( rows.size() == 3 && rows[1] == huge && rows[2] == "b" );
+
+    // read errors are not mistaken for the end of the input
+    std::istream broken( 0 );
+    wire::token_stream bad_stream( broken, "\n" ), bad_fd( -1, "\n" );
+    wire::view ignored;
+    test1( !bad_stream.next( ignored ) && !bad_stream.good() );
+    test1( !bad_fd.next( ignored ) && !bad_fd.good() );
+    std::istringstream whole( "a," + huge );
+    wire::token_stream clean( whole, "," );
+    while( clean.next( ignored ) ) {}
+    test1( clean.good() );
+
+    std::istringstream none( "" ), blank( "\n" );
+    test1( wire::token_stream( none, "\n", wire::token_stream::lines ).begin() == wire::token_stream::iterator() );
+    wire::token_stream one( blank, "\n", wire::token_stream::lines );
+    wire::view row( "?" );
+    test1( one.next( row ) && row.empty() && !one.next( row ) );
+    }
+
+    /* allocator-aware strings (c++17 pmr) */ {
+#ifdef __cpp_lib_memory_resource
+    // every result must come from the arena: the default resource is swapped for one that throws
+    static char storage[ 1 << 16 ];
+    std::pmr::monotonic_buffer_resource arena( storage, sizeof( storage ), std::pmr::null_memory_resource() );
+    std::pmr::memory_resource *previous = std::pmr::set_default_resource( std::pmr::null_memory_resource() );
+    bool arena_only = true;
+    try {
+        wire::pmr::string csv( "alpha-alpha-alpha,beta-beta-beta;gamma-gamma-gamma", &arena );
+        wire::pmr::strings fields( csv.tokenize( ",;" ) );
+        wire::pmr::string upper = csv.uppercase(), swapped = csv.replace( "-", "+" ), left = csv.left_of( ";" );
+        wire::pmr::string padded( "   padded and stripped string   ", &arena ), stripped = padded.strip();
+        wire::pmr::string line( "\1 fields, first is \2", &arena );
+        line( fields.size(), fields[0] );
+        size_t before = ctest_allocations;
+        size_t joined = fields.str( "<\1>\n", "[", "]" ).size();
+        size_t joiner_allocations = ctest_allocations - before;
+        std::pmr::set_default_resource( previous ); // test3() copies its operands
+        test3( joined, ==, csv.size() - 2 + 3 * 3 + 2 );
+        test3( joiner_allocations, ==, 0 );
+        test3( fields.size(), ==, 3 );
+        test3( fields[-1], ==, "gamma-gamma-gamma" );
+        test3( upper, ==, "ALPHA-ALPHA-ALPHA,BETA-BETA-BETA;GAMMA-GAMMA-GAMMA" );
+        test3( swapped.left_of( "," ), ==, "alpha+alpha+alpha" );
+        test3( left, ==, "alpha-alpha-alpha,beta-beta-beta" );
+        test3( stripped, ==, "padded and stripped string" );
+        test3( line, ==, "3 fields, first is alpha-alpha-alpha" );
+        test3( fields.str( "\1", "[", "]" ).size(), ==, csv.size() );
+        test1( fields.get_allocator().resource() == &arena );
+        test1( fields[1].get_allocator().resource() == &arena );
+        test1( upper.get_allocator().resource() == &arena && swapped.get_allocator().resource() == &arena );
+        test1( stripped.get_allocator().resource() == &arena && line.get_allocator().resource() == &arena );
+    } catch( const std::bad_alloc & ) {
+        arena_only = false;
+        std::pmr::set_default_resource( previous );
+    }
+    test1( arena_only );
+#endif
+    }
+
+    /* instrumentation counters (all zeros unless built with -DWIRE_STATS) */ {
+    using namespace wire::stats;
+    const wire::string csv = "a,bb;ccc", empty;
+    table before = snapshot();
+    size_t tokens = csv.tokenize( ",;" ).size();
+    std::thread( [&] { csv.matches( "a*" ); } ).join();
+    std::string line = wire::format( "%d-%d", 12, 34 );
+    char fallback = empty.at( 1 );
+    table delta = snapshot() - before;
+    test3( tokens, ==, 3 );
+    test3( fallback, ==, '\0' );
+    test3( delta[ tokenize ].calls, ==, enabled ? 1 : 0 );
+    test3( delta[ tokenize ].bytes_in, ==, enabled ? csv.size() : 0 );
+    test3( delta[ tokenize ].bytes_out, ==, enabled ? 6 : 0 );
+    test3( delta[ matches ].calls, ==, enabled ? 1 : 0 );
+    test3( delta[ format ].bytes_out, ==, enabled ? line.size() : 0 );
+    test3( delta[ at_fallback ].calls, ==, enabled ? 1 : 0 );
+    test3( delta[ split ].calls, ==, 0 );
+    test1( enabled ? delta.str().find( "tokenize" ) != std::string::npos : delta.str().empty() );
+    }
+
     // Other tests
     tests_from_string_sample();
 
@@ -5,8 +5,6 @@
  * wire::format() based on code by Tom Distler (see http://goo.gl/KPT66)
 
  * @todo:
- * - string::replace_map(): specialize for target_t == char || replacement_t == char
- * - string::replace_map(): specialize for (typename<size_t N> const char (&from)[N], const char (&to)[N])
  * - strings::subset( 0, EOF )
  * - strings::subset( N, EOF )
  * - strings::subset( 0, -1 ) -> 0, EOF - 1
@@ -18,18 +16,25 @@
 #pragma once
 
 #include <cctype>
+#include <clocale>
+#include <cmath>
 #include <cstdarg>
+#include <cstdint>
 #include <cstdio>
 #include <cstring>
 
 #include <algorithm>
 #include <deque>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
 #include <limits>
 #include <map>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #define WIRE_VERSION "2.2.0" /* (2016/04/18) - Moved getopt to a library apart.
@@ -46,44 +51,335 @@
 #    define wire$vsnprintf  vsnprintf
 #endif
 
+// SIMD kernels (define WIRE_NO_SIMD to build the scalar fallbacks only)
+#if !defined(WIRE_NO_SIMD) && ( defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) )
+#    define wire$sse2 1
+#    include <emmintrin.h>
+#endif
+#if !defined(WIRE_NO_SIMD) && defined(__AVX2__)
+#    define wire$avx2 1
+#    include <immintrin.h>
+#endif
+#ifdef _MSC_VER
+#    include <intrin.h>
+#endif
+
+// Opt-in file descriptor support (define WIRE_FD): wire::sink( int fd ) and the token_stream fd
+// constructor. It includes <unistd.h> (<io.h> on Windows); without it only the standard library is.
+#ifdef WIRE_FD
+#    define wire$fd 1
+#    ifdef _WIN32
+#        include <io.h>
+#        define wire$read _read
+#        define wire$write _write
+#    else
+#        include <unistd.h>
+#        define wire$read ::read
+#        define wire$write ::write
+#    endif
+#endif
+// Opt-in memory mapping for wire::mapped_string (define WIRE_MMAP, POSIX only); otherwise files
+// are read into the heap with std::fread.
+#if defined(WIRE_MMAP) && ( defined(__unix__) || defined(__APPLE__) )
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#    define wire$mmap 1
+#endif
+#include <cerrno>
+
+#if __cplusplus >= 201703L || ( defined(_MSVC_LANG) && _MSVC_LANG >= 201703L )
+#    define wire$cpp17 1
+#    include <string_view>
+#    ifdef __has_include
+#        if __has_include(<memory_resource>)
+#            define wire$pmr 1
+#            include <memory_resource>
+#        endif
+#    endif
+#endif
+
+// Opt-in instrumentation (define WIRE_STATS): per-api calls, input/output bytes, heap allocations and
+// cycles, kept in lock-free per-thread blocks and summed by wire::stats::snapshot(). Without
+// WIRE_STATS no probe is compiled in and snapshot() is all zeros.
+#ifdef WIRE_STATS
+#    include <atomic>
+#    include <chrono>
+#endif
+
 namespace wire
 {
-    /* Public API */
-    // Function tools
+    namespace stats
+    {
+        enum api { format, safe_format, conversion, replace, replace_map, tokenize, split, matches, at_fallback, api_count };
 
-    // Function to do safe C-style formatting
-    static inline std::string format( const char *fmt, ... ) {
-        int len;
-        std::string self;
-        using namespace std;
+        inline const char *name( api a ) {
+            static const char *names[] = { "format", "safe_format", "conversion", "replace", "replace_map",
+                "tokenize", "split", "matches", "at_fallback" };
+            return a < api_count ? names[ a ] : "?";
+        }
 
-        // Calculate the final length of the formatted string
-        {
-            va_list args;
-            va_start( args, fmt );
-            len = wire$vsnprintf( 0, 0, fmt, args );
-            va_end( args );
+        // allocations are estimated from the heap blocks the result gained (buffer growth, list nodes)
+        struct counters {
+            uint64_t calls, bytes_in, bytes_out, allocations, cycles;
+        };
+
+        struct table {
+            counters apis[ api_count ];
+
+            const counters &operator[]( api a ) const {
+                return apis[ a ];
+            }
+
+            // activity between an earlier snapshot and this one
+            table operator-( const table &earlier ) const {
+                table t = *this;
+                for( unsigned i = 0; i < api_count; ++i ) {
+                    t.apis[i].calls -= earlier.apis[i].calls;
+                    t.apis[i].bytes_in -= earlier.apis[i].bytes_in;
+                    t.apis[i].bytes_out -= earlier.apis[i].bytes_out;
+                    t.apis[i].allocations -= earlier.apis[i].allocations;
+                    t.apis[i].cycles -= earlier.apis[i].cycles;
+                }
+                return t;
+            }
+
+            // one line per api that was called
+            std::string str() const {
+                std::string out;
+                char line[ 160 ];
+                for( unsigned i = 0; i < api_count; ++i ) {
+                    const counters &c = apis[i];
+                    if( !c.calls ) continue;
+                    int n = std::snprintf( line, sizeof(line), "%-12s calls=%llu in=%llu out=%llu allocs=%llu cycles=%llu\n",
+                        name( api(i) ), (unsigned long long)c.calls, (unsigned long long)c.bytes_in, (unsigned long long)c.bytes_out,
+                        (unsigned long long)c.allocations, (unsigned long long)c.cycles );
+                    if( n > 0 ) out.append( line, std::min( size_t( n ), sizeof(line) - 1 ) );
+                }
+                return out;
+            }
+        };
+
+#ifdef WIRE_STATS
+        enum { enabled = 1 };
+
+        // cycle counter: rdtsc where available, else nanoseconds
+        inline uint64_t cycles() {
+#if defined(_MSC_VER) && ( defined(_M_X64) || defined(_M_IX86) )
+            return __rdtsc();
+#elif defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+            return __builtin_ia32_rdtsc();
+#else
+            return uint64_t( std::chrono::duration_cast< std::chrono::nanoseconds >( std::chrono::steady_clock::now().time_since_epoch() ).count() );
+#endif
         }
 
-        // Allocate a buffer (including room for null termination)
-        char* target_string = new char[++len];
+        // Each thread only writes its own block, with plain relaxed load/store pairs (no locked
+        // instructions); readers may see a block mid-update but never a torn counter.
+        struct block {
+            std::atomic< uint64_t > values[ api_count ][ 5 ];
 
-        // Generate the formatted string
-        {
-            va_list args;
-            va_start( args, fmt );
-            wire$vsnprintf( target_string, len, fmt, args );
-            va_end( args );
+            block() {
+                for( auto &row : values ) for( auto &v : row ) v.store( 0, std::memory_order_relaxed );
+            }
+            void add( api a, unsigned field, uint64_t n ) {
+                std::atomic< uint64_t > &v = values[ a ][ field ];
+                v.store( v.load( std::memory_order_relaxed ) + n, std::memory_order_relaxed );
+            }
+            void sum_into( table &t ) const {
+                for( unsigned i = 0; i < api_count; ++i ) {
+                    counters &c = t.apis[i];
+                    c.calls += values[i][0].load( std::memory_order_relaxed );
+                    c.bytes_in += values[i][1].load( std::memory_order_relaxed );
+                    c.bytes_out += values[i][2].load( std::memory_order_relaxed );
+                    c.allocations += values[i][3].load( std::memory_order_relaxed );
+                    c.cycles += values[i][4].load( std::memory_order_relaxed );
+                }
+            }
+        };
+
+        // blocks of running threads, plus the totals of the threads that exited.
+        // The mutex is only taken on thread start/exit and by snapshot().
+        struct registry {
+            std::mutex lock;
+            std::vector< const block * > threads;
+            table retired;
+        };
+        inline registry &threads() {
+            static registry *r = new registry();   // never destroyed: threads may exit after static destructors
+            return *r;
+        }
+
+        struct thread_block {
+            block counters;
+            thread_block() {
+                registry &r = threads();
+                std::lock_guard< std::mutex > guard( r.lock );
+                r.threads.push_back( &counters );
+            }
+            ~thread_block() {
+                registry &r = threads();
+                std::lock_guard< std::mutex > guard( r.lock );
+                counters.sum_into( r.retired );
+                r.threads.erase( std::find( r.threads.begin(), r.threads.end(), &counters ) );
+            }
+        };
+        inline block &local() {
+            static thread_local thread_block mine;
+            return mine.counters;
+        }
+
+        inline table snapshot() {
+            registry &r = threads();
+            std::lock_guard< std::mutex > guard( r.lock );
+            table t = r.retired;
+            for( const block *b : r.threads ) b->sum_into( t );
+            return t;
+        }
+
+        // Scoped probe behind the wire$stats() macros: counts one call and its cycles. When given
+        // an output string, the bytes appended to it and whether its buffer grew are counted too.
+        class probe {
+            block &counters;
+            api which;
+            uint64_t start;
+            const void *out;
+            size_t (*measure)( const void *, bool capacity );
+            size_t size, capacity;
+
+            template< typename S >
+            static size_t measure_string( const void *s, bool capacity ) {
+                return capacity ? static_cast< const S * >( s )->capacity() : static_cast< const S * >( s )->size();
+            }
+
+            probe( const probe & );
+            probe &operator=( const probe & );
+
+            public:
+
+            probe( api a, size_t in ) : counters( local() ), which( a ), out( 0 ), measure( 0 ), size( 0 ), capacity( 0 ) {
+                counters.add( which, 0, 1 );
+                counters.add( which, 1, in );
+                start = cycles();
+            }
+            template< typename S >
+            probe( api a, size_t in, const S *output ) : counters( local() ), which( a ), out( output ), measure( &measure_string< S > ),
+                size( output->size() ), capacity( output->capacity() ) {
+                counters.add( which, 0, 1 );
+                counters.add( which, 1, in );
+                start = cycles();
+            }
+            ~probe() {
+                if( out ) {
+                    size_t now = measure( out, false );
+                    produced( now - std::min( size, now ), measure( out, true ) > capacity );
+                }
+                counters.add( which, 4, cycles() - start );
+            }
+            void produced( size_t bytes, size_t allocations ) {
+                counters.add( which, 2, bytes );
+                counters.add( which, 3, allocations );
+            }
+            // a list of strings: its bytes, the strings past the small-string buffer and the list nodes
+            template< typename LIST >
+            void produced_list( const LIST &list ) {
+                static const size_t small = std::string().capacity();
+                size_t bytes = 0, heap = list.empty() ? 0 : 1 + list.size() * sizeof( typename LIST::value_type ) / 512;
+                for( const typename LIST::value_type &s : list ) bytes += s.size(), heap += s.capacity() > small;
+                produced( bytes, heap );
+            }
+        };
+#else
+        enum { enabled = 0 };
+
+        inline table snapshot() {
+            return table();
+        }
+#endif
+
+        inline std::ostream &dump( std::ostream &out = std::cerr ) {
+            return out << snapshot().str();
         }
+    }
+}
+
+#ifdef WIRE_STATS
+#    define wire$stats( API, IN )            wire::stats::probe wire$probe( wire::stats::API, IN )
+#    define wire$stats_into( API, IN, OUT )  wire::stats::probe wire$probe( wire::stats::API, IN, &(OUT) )
+#    define wire$stats_out( BYTES, ALLOCS )  wire$probe.produced( BYTES, ALLOCS )
+#    define wire$stats_list( LIST )          wire$probe.produced_list( LIST )
+#else
+#    define wire$stats( API, IN )
+#    define wire$stats_into( API, IN, OUT )
+#    define wire$stats_out( BYTES, ALLOCS )
+#    define wire$stats_list( LIST )
+#endif
+
+namespace wire
+{
+    /* Public API */
+    // Function tools
 
-        // Assign the formatted string
-        self.assign( target_string );
+    // Function to do safe C-style formatting, appending to an existing string.
+    // Formats into a stack buffer first, so only results over 512 bytes take a second pass.
+    static inline std::string &vformat_append( std::string &out, const char *fmt, va_list args ) {
+        wire$stats_into( format, fmt ? std::strlen( fmt ) : 0, out );
+        char stack[ 512 ];
+        int len;
+        {
+            va_list copy;
+            va_copy( copy, args );
+            len = wire$vsnprintf( stack, sizeof(stack), fmt, copy );
+            va_end( copy );
+        }
+        if( len < 0 ) {
+            // pre-C99 runtimes report truncation as -1; ask for the length instead
+            va_list copy;
+            va_copy( copy, args );
+            len = wire$vsnprintf( 0, 0, fmt, copy );
+            va_end( copy );
+            if( len < 0 ) return out;
+        }
+        if( size_t( len ) < sizeof(stack) )
+            return out.append( stack, size_t( len ) );
+
+        // overflow: grow out exactly once and format straight into it (the terminator slot included)
+        size_t old = out.size();
+        out.resize( old + size_t( len ) );
+        wire$vsnprintf( &out[ old ], size_t( len ) + 1, fmt, args );
+        return out;
+    }
 
-        // Clean up
-        delete [] target_string;
+    // Function to do safe C-style formatting
+    static inline std::string format( const char *fmt, ... ) {
+        std::string self;
+        va_list args;
+        va_start( args, fmt );
+        vformat_append( self, fmt, args );
+        va_end( args );
         return self;
     }
 
+    // Function to do safe C-style formatting into out, replacing its contents but keeping its capacity
+    static inline std::string &format_to( std::string &out, const char *fmt, ... ) {
+        out.clear();
+        va_list args;
+        va_start( args, fmt );
+        vformat_append( out, fmt, args );
+        va_end( args );
+        return out;
+    }
+
+    // Function to do safe C-style formatting at the end of out
+    static inline std::string &format_append( std::string &out, const char *fmt, ... ) {
+        va_list args;
+        va_start( args, fmt );
+        vformat_append( out, fmt, args );
+        va_end( args );
+        return out;
+    }
+
     // Function to convert strings <-> numbers in most precise way (C99)
     static inline std::string precise( const long double &t ) {
         /**/ if( t ==  std::numeric_limits< long double >::infinity() ) return  "INF";
@@ -101,708 +397,3022 @@ namespace wire
         return ld;
     }
 
+    // Non-owning slice of a string buffer, as yielded by the *_view() methods.
+    // It is only valid while the buffer it points into is alive and unmodified.
+    class view
+    {
+        const char *ptr;
+        size_t len;
+
+        public:
+
+        view() : ptr(""), len(0)
+        {}
+        view( const char *p, size_t n ) : ptr(p), len(n)
+        {}
+        view( const char *cstr ) : ptr(cstr ? cstr : ""), len(cstr ? std::strlen(cstr) : 0)
+        {}
+        view( const std::string &s ) : ptr(s.data()), len(s.size())
+        {}
+        template< typename A >
+        view( const std::basic_string< char, std::char_traits< char >, A > &s ) : ptr(s.data()), len(s.size())
+        {}
+
+        const char *data() const { return ptr; }
+        size_t size() const { return len; }
+        bool empty() const { return !len; }
+        const char *begin() const { return ptr; }
+        const char *end() const { return ptr + len; }
+        char operator[]( size_t i ) const { return ptr[i]; }
+
+        std::string str() const { return std::string( ptr, len ); }
+        operator std::string() const { return str(); }
+#ifdef wire$cpp17
+        operator std::string_view() const { return std::string_view( ptr, len ); }
+#endif
+
+        friend bool operator ==( const view &a, const view &b ) {
+            return a.len == b.len && !std::memcmp( a.ptr, b.ptr, a.len );
+        }
+        friend bool operator ==( const view &a, const std::string &b ) { return a == view( b ); }
+        friend bool operator ==( const std::string &a, const view &b ) { return view( a ) == b; }
+        friend bool operator ==( const view &a, const char *b ) { return a == view( b ); }
+        friend bool operator !=( const view &a, const view &b ) { return !( a == b ); }
+        friend bool operator !=( const view &a, const std::string &b ) { return !( a == b ); }
+        friend bool operator !=( const std::string &a, const view &b ) { return !( a == b ); }
+        friend bool operator !=( const view &a, const char *b ) { return !( a == b ); }
+
+        friend std::ostream &operator <<( std::ostream &os, const view &self ) {
+            return os.write( self.ptr, std::streamsize( self.len ) );
+        }
+    };
+
+    class atom;
+
+    // Streaming destination for the formatters and joiners: a std::ostream, a FILE*, a file
+    // descriptor (with WIRE_FD), a callback or a std::string. Output is gathered in a fixed chunk buffer and handed
+    // over chunk by chunk (strings are appended to directly), so streaming any amount of output
+    // takes constant memory. The rest is flushed on flush() and on destruction.
+    class sink
+    {
+        enum target { to_stream, to_file, to_fd, to_callback, to_string };
+        enum { chunk_size = 4096 };
+
+        target kind;
+        std::ostream *os;
+        FILE *fp;
+        int fd;
+        std::function< void( const char *, size_t ) > fn;
+        std::string *text;
+        size_t used;
+        char chunk[ chunk_size ];
+
+        void init( target k ) {
+            kind = k, os = 0, fp = 0, fd = -1, text = 0, used = 0;
+        }
+
+        void push( const char *p, size_t n ) {
+            switch( kind ) {
+                case to_stream:   os->write( p, std::streamsize( n ) ); break;
+                case to_file:     std::fwrite( p, 1, n, fp ); break;
+                case to_callback: fn( p, n ); break;
+                case to_string:   text->append( p, n ); break;
+                case to_fd:
+#ifdef wire$fd
+                    while( n ) {
+                        long written = long( wire$write( fd, p, (unsigned)( n < (1u << 30) ? n : (1u << 30) ) ) );
+                        if( written < 0 && errno == EINTR ) continue;
+                        if( written <= 0 ) break;
+                        p += written, n -= size_t( written );
+                    }
+#endif
+                    break;
+            }
+        }
+
+        sink( const sink & );
+        sink &operator=( const sink & );
+
+        public:
+
+        explicit sink( std::ostream &out ) { init( to_stream ); os = &out; }
+        explicit sink( FILE *out ) { init( to_file ); fp = out; }
+#ifdef wire$fd
+        explicit sink( int out_fd ) { init( to_fd ); fd = out_fd; }
+#endif
+        explicit sink( std::string &out ) { init( to_string ); text = &out; }
+        explicit sink( const std::function< void( const char *, size_t ) > &out ) { init( to_callback ); fn = out; }
+
+        ~sink() {
+            flush();
+        }
+
+        sink &append( const char *p, size_t n ) {
+            if( kind == to_string ) return text->append( p, n ), *this;
+            if( n > chunk_size - used ) {
+                flush();
+                if( n >= chunk_size ) return push( p, n ), *this;
+            }
+            std::memcpy( chunk + used, p, n );
+            used += n;
+            return *this;
+        }
+        sink &append( const std::string &s ) {
+            return append( s.data(), s.size() );
+        }
+
+        void flush() {
+            if( used ) push( chunk, used ), used = 0;
+        }
+    };
+
+    // Function to do safe C-style formatting into a sink
+    static inline sink &vformat( sink &out, const char *fmt, va_list args ) {
+        char stack[ 512 ];
+        va_list copy;
+        va_copy( copy, args );
+        int len = wire$vsnprintf( stack, sizeof(stack), fmt, copy );
+        va_end( copy );
+        if( len >= 0 && size_t( len ) < sizeof(stack) ) {
+            wire$stats( format, fmt ? std::strlen( fmt ) : 0 );
+            wire$stats_out( size_t( len ), 0 );
+            return out.append( stack, size_t( len ) );
+        }
+        std::string big;
+        vformat_append( big, fmt, args );
+        return out.append( big );
+    }
+
+    static inline sink &format( sink &out, const char *fmt, ... ) {
+        va_list args;
+        va_start( args, fmt );
+        vformat( out, fmt, args );
+        va_end( args );
+        return out;
+    }
+
     /* Public API */
     // Main class
 
     namespace
     {
+        inline const char *skip_spaces( const char *p, const char *end ) {
+            while( p < end && ( *p == ' ' || unsigned( *p - '\t' ) < 5 ) ) ++p;
+            return p;
+        }
+
+        // from_chars-like scanners that follow std::istream >> T rules: leading spaces are skipped,
+        // the longest valid prefix is converted and overflows fail. They return the end of the
+        // number or 0 on failure, and never allocate.
+
+        template< typename T >
+        inline const char *parse_integer( const char *p, const char *end, T &out ) {
+            typedef unsigned long long U;
+            p = skip_spaces( p, end );
+            bool neg = false;
+            if( p < end && ( *p == '-' || *p == '+' ) ) neg = ( *p++ == '-' );
+            // unsigned types accept a sign and wrap around, as streams do
+            const U limit = U( std::numeric_limits< T >::max() ) + ( std::is_signed< T >::value && neg );
+            const char *digits = p;
+            U v = 0;
+            for( ; p < end && unsigned( *p - '0' ) < 10; ++p ) {
+                unsigned d = unsigned( *p - '0' );
+                if( v > ( limit - d ) / 10 ) return 0;
+                v = v * 10 + d;
+            }
+            if( p == digits ) return 0;
+            out = T( neg ? U(0) - v : v );
+            return p;
+        }
+
+        template< typename T >
+        inline const char *parse_real( const char *p, const char *end, T &out ) {
+            static const T pow10[] = {
+                T(1e0L), T(1e1L), T(1e2L), T(1e3L), T(1e4L), T(1e5L), T(1e6L), T(1e7L), T(1e8L), T(1e9L),
+                T(1e10L), T(1e11L), T(1e12L), T(1e13L), T(1e14L), T(1e15L), T(1e16L), T(1e17L), T(1e18L), T(1e19L),
+                T(1e20L), T(1e21L), T(1e22L), T(1e23L), T(1e24L), T(1e25L), T(1e26L), T(1e27L) };
+            // largest power of ten and mantissa that T holds exactly (float, double, 80-bit long double)
+            enum { bits = std::numeric_limits< T >::digits, max_pow = bits >= 64 ? 27 : bits >= 53 ? 22 : 10 };
+
+            p = skip_spaces( p, end );
+            const char *start = p;
+            bool neg = false;
+            if( p < end && ( *p == '-' || *p == '+' ) ) neg = ( *p++ == '-' );
+
+            unsigned long long m = 0;
+            int digits = 0, exp10 = 0;
+            bool any = false, truncated = false;
+            for( ; p < end && unsigned( *p - '0' ) < 10; ++p, any = true ) {
+                if( digits < 19 ) m = m * 10 + unsigned( *p - '0' ), digits += ( m != 0 );
+                else ++exp10, truncated = true;
+            }
+            if( p < end && *p == '.' ) {
+                for( ++p; p < end && unsigned( *p - '0' ) < 10; ++p, any = true ) {
+                    if( digits < 19 ) m = m * 10 + unsigned( *p - '0' ), digits += ( m != 0 ), --exp10;
+                    else truncated = true;
+                }
+            }
+            if( !any ) return 0;
+            if( p < end && ( *p == 'e' || *p == 'E' ) ) {
+                // streams consume a dangling exponent and then fail
+                bool eneg = false;
+                if( ++p < end && ( *p == '-' || *p == '+' ) ) eneg = ( *p++ == '-' );
+                int e = 0;
+                const char *edigits = p;
+                for( ; p < end && unsigned( *p - '0' ) < 10; ++p )
+                    if( e < 100000 ) e = e * 10 + ( *p - '0' );
+                if( p == edigits ) return 0;
+                exp10 += eneg ? -e : e;
+            }
+
+            if( !truncated && ( bits >= 64 || m <= ( 1ull << (bits < 64 ? bits : 63) ) ) && exp10 >= -max_pow && exp10 <= max_pow ) {
+                T v = exp10 < 0 ? T( m ) / pow10[ -exp10 ] : T( m ) * pow10[ exp10 ];
+                out = neg ? -v : v;
+                return p;
+            }
+
+            // slow path: C strtod family over a terminated copy, with the C decimal point
+            char local[ 64 ];
+            std::string heap;
+            size_t len = size_t( p - start );
+            char *copy = len < sizeof(local) ? local : ( heap.assign( len + 1, '\0' ), &heap[0] );
+            std::memcpy( copy, start, len );
+            copy[ len ] = '\0';
+            const char *point = std::localeconv()->decimal_point;
+            if( point && point[0] != '.' && point[0] )
+                std::replace( copy, copy + len, '.', point[0] );
+            long double v = sizeof(T) <= sizeof(float) ? std::strtof( copy, 0 ) :
+                            sizeof(T) <= sizeof(double) ? std::strtod( copy, 0 ) : std::strtold( copy, 0 );
+            if( v == std::numeric_limits< long double >::infinity() || v == -std::numeric_limits< long double >::infinity() )
+                return 0;
+            out = T( v );
+            return p;
+        }
+
+        enum { parse_as_bool, parse_as_integer, parse_as_real, parse_as_stream };
+
+        template< typename T >
+        struct parse_kind {
+            enum { value =
+                std::is_same< T, bool >::value ? parse_as_bool :
+                std::is_integral< T >::value ? parse_as_integer :
+                std::is_floating_point< T >::value ? parse_as_real : parse_as_stream };
+        };
+
+        template< typename T >
+        inline const char *parse( const char *p, const char *end, T &t, std::integral_constant< int, parse_as_bool > ) {
+            // streams without std::boolalpha only take 0 or 1
+            long long v;
+            p = parse_integer( p, end, v );
+            return p && ( v == 0 || v == 1 ) ? ( t = ( v == 1 ), p ) : 0;
+        }
+        template< typename T >
+        inline const char *parse( const char *p, const char *end, T &t, std::integral_constant< int, parse_as_integer > ) {
+            return parse_integer( p, end, t );
+        }
+        template< typename T >
+        inline const char *parse( const char *p, const char *end, T &t, std::integral_constant< int, parse_as_real > ) {
+            return parse_real( p, end, t );
+        }
+        template< typename T >
+        inline const char *parse( const char *p, const char *end, T &t, std::integral_constant< int, parse_as_stream > ) {
+            std::istringstream is( std::string( p, end ) );
+            if( !( is >> t ) ) return 0;
+            std::streamoff consumed = is.eof() ? std::streamoff( end - p ) : std::streamoff( is.tellg() );
+            return p + consumed;
+        }
         template< typename T >
-        inline T as( const std::string &self ) {
+        inline const char *parse( const char *p, const char *end, T &t ) {
+            return parse( p, end, t, std::integral_constant< int, parse_kind< T >::value >() );
+        }
+
+        // the conversions below accept any string type: std::string, wire::string or one with another allocator
+
+        template< typename S >
+        inline bool is_true( const S &self ) {
+            size_t len = self.size();
+            const char *data = self.data();
+            return len && !( len == 1 && data[0] == '0' ) && !( len == 5 && !std::memcmp( data, "false", 5 ) );
+        }
+
+        template< typename T, typename S >
+        inline T as( const S &self, T * ) {
             T t;
-            if( std::istringstream(self) >> t )
+            if( parse( self.data(), self.data() + self.size(), t ) )
                 return t;
-            bool is_true = self.size() && (self != "0") && (self != "false");
-            return (T)(is_true);
+            return (T)( is_true( self ) );
         }
 
-        template<>
-        inline char as( const std::string &self ) {
-            return self.size() == 1 ? (char)(self[0]) : (char)(as<int>(self));
+        template< typename S >
+        inline char as( const S &self, char * ) {
+            return self.size() == 1 ? (char)(self[0]) : (char)(as( self, (int *)0 ));
         }
-        template<>
-        inline signed char as( const std::string &self ) {
-            return self.size() == 1 ? (signed char)(self[0]) : (signed char)(as<int>(self));
+        template< typename S >
+        inline signed char as( const S &self, signed char * ) {
+            return self.size() == 1 ? (signed char)(self[0]) : (signed char)(as( self, (int *)0 ));
+        }
+        template< typename S >
+        inline unsigned char as( const S &self, unsigned char * ) {
+            return self.size() == 1 ? (unsigned char)(self[0]) : (unsigned char)(as( self, (int *)0 ));
+        }
+
+        template< typename S >
+        inline const char *as( const S &self, const char ** ) {
+            return self.c_str();
+        }
+        template< typename S >
+        inline std::string as( const S &self, std::string * ) {
+            return std::string( self.data(), self.size() );
+        }
+
+        template< typename T, typename S >
+        inline T as( const S &self ) {
+            return as( self, (T *)0 );
+        }
+
+        // strict conversion: the whole string (but surrounding spaces) must parse, else t is untouched
+        template< typename S, typename T >
+        inline bool try_as( const S &self, T &t ) {
+            const char *end = self.data() + self.size();
+            T v;
+            const char *stop = parse( self.data(), end, v );
+            if( !stop || skip_spaces( stop, end ) != end )
+                return false;
+            return t = v, true;
+        }
+
+        template< typename S >
+        inline bool try_as( const S &self, bool &t ) {
+            if( self.size() == 4 && !std::memcmp( self.data(), "true", 4 ) ) return t = true, true;
+            if( self.size() == 5 && !std::memcmp( self.data(), "false", 5 ) ) return t = false, true;
+            bool v;
+            const char *end = self.data() + self.size(), *stop = parse( self.data(), end, v );
+            return stop && skip_spaces( stop, end ) == end ? ( t = v, true ) : false;
+        }
+
+        template< typename S, typename C >
+        inline bool try_as_char( const S &self, C &t ) {
+            if( self.size() == 1 ) return t = C( self[0] ), true;
+            int v;
+            if( !try_as( self, v ) || v < int( std::numeric_limits< C >::min() ) || v > int( std::numeric_limits< C >::max() ) )
+                return false;
+            return t = C( v ), true;
+        }
+        template< typename S >
+        inline bool try_as( const S &self, char &t ) {
+            return try_as_char( self, t );
+        }
+        template< typename S >
+        inline bool try_as( const S &self, signed char &t ) {
+            return try_as_char( self, t );
+        }
+        template< typename S >
+        inline bool try_as( const S &self, unsigned char &t ) {
+            return try_as_char( self, t );
+        }
+        template< typename S >
+        inline bool try_as( const S &self, std::string &t ) {
+            return t.assign( self.data(), self.size() ), true;
+        }
+    }
+
+    namespace
+    {
+        // Rendered argument of a safe format: a span over the argument bytes when these are
+        // already text, or over a small local buffer otherwise. User types go through a stream.
+        struct piece {
+            const char *ptr;
+            size_t len;
+            char buf[ 64 ];
+            std::string spill;
+
+            piece() : ptr(""), len(0)
+            {}
+
+            void set( const char *p, size_t n ) {
+                ptr = p, len = n;
+            }
+        };
+
+        enum { is_text, is_cstr, is_char, is_bool, is_integer, is_real, is_other };
+
+        // std::basic_string<char> with any allocator, or a class derived from one (wire::string...)
+        template< typename T >
+        struct text_string {
+            template< typename A >
+            static std::true_type test( const std::basic_string< char, std::char_traits< char >, A > * );
+            static std::false_type test( ... );
+            enum { value = decltype( test( (T *)0 ) )::value };
+        };
+
+        // mirrors the wire::string(const T &) constructor overload picked for T
+        template< typename T >
+        struct render_kind {
+            typedef typename std::remove_cv< typename std::remove_extent< T >::type >::type element;
+            enum { value =
+                text_string< T >::value || std::is_same< T, view >::value || std::is_same< T, atom >::value ? is_text :
+                std::is_same< T, char * >::value || std::is_same< T, const char * >::value ? is_cstr :
+                std::is_array< T >::value && std::is_same< element, char >::value ? is_cstr :
+                std::is_same< T, char >::value || std::is_same< T, signed char >::value || std::is_same< T, unsigned char >::value ? is_char :
+                std::is_same< T, bool >::value ? is_bool :
+                std::is_integral< T >::value ? is_integer :
+                std::is_floating_point< T >::value ? is_real : is_other };
+        };
+
+        template< typename T >
+        inline void render( piece &p, const T &t, std::integral_constant< int, is_text > ) {
+            p.set( t.data(), t.size() );
+        }
+        template< typename T >
+        inline void render( piece &p, const T &t, std::integral_constant< int, is_cstr > ) {
+            const char *cstr = t;
+            cstr ? p.set( cstr, std::strlen( cstr ) ) : p.set( "", 0 );
+        }
+        template< typename T >
+        inline void render( piece &p, const T &t, std::integral_constant< int, is_char > ) {
+            p.buf[ 0 ] = char( t );
+            p.set( p.buf, 1 );
+        }
+        template< typename T >
+        inline void render( piece &p, const T &t, std::integral_constant< int, is_bool > ) {
+            t ? p.set( "true", 4 ) : p.set( "false", 5 );
+        }
+        static const char digit_pairs[] =
+            "00010203040506070809" "10111213141516171819" "20212223242526272829" "30313233343536373839"
+            "40414243444546474849" "50515253545556575859" "60616263646566676869" "70717273747576777879"
+            "80818283848586878889" "90919293949596979899";
+
+        // writes v backwards ending at end, two digits per division
+        template< typename U >
+        inline char *render_digits( char *end, U v ) {
+            while( v >= 100 ) {
+                const char *pair = &digit_pairs[ unsigned( v % 100 ) * 2 ];
+                v /= 100;
+                *--end = pair[1], *--end = pair[0];
+            }
+            if( v < 10 ) {
+                *--end = char( '0' + unsigned( v ) );
+            } else {
+                const char *pair = &digit_pairs[ unsigned( v ) * 2 ];
+                *--end = pair[1], *--end = pair[0];
+            }
+            return end;
+        }
+
+        template< typename T >
+        inline void render( piece &p, const T &t, std::integral_constant< int, is_integer > ) {
+            // 32-bit math whenever the type fits, as 64-bit divisions are noticeably slower
+            typedef typename std::conditional< sizeof(T) <= sizeof(unsigned), unsigned, unsigned long long >::type U;
+            char *end = p.buf + sizeof(p.buf), *begin;
+            if( t < T(0) ) {
+                begin = render_digits( end, U( U(0) - U(t) ) );
+                *--begin = '-';
+            } else {
+                begin = render_digits( end, U( t ) );
+            }
+            p.set( begin, size_t( end - begin ) );
+        }
+
+        // C-locale %.6Lg, which is what std::ostream << (long double)t prints with default flags.
+        inline size_t render_real_printf( char *buf, size_t cap, long double t ) {
+            int len = std::snprintf( buf, cap, "%.6Lg", t );
+            const char *point = std::localeconv()->decimal_point;
+            if( point && point[0] != '.' && point[0] )
+                std::replace( buf, buf + len, point[0], '.' );
+            return size_t( len );
+        }
+
+        // Fast %.6Lg for values printed in fixed notation (1e-4 <= |t| < 1e6): the value is scaled to
+        // six integer digits with a single exact power of ten. Rounding ties (or anything too close to
+        // one to be decided in R precision) and all other ranges go through snprintf.
+        template< typename R >
+        inline size_t render_real( char *buf, size_t cap, R t ) {
+            static const R pow10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+            R a = t < 0 ? -t : t;
+            if( a == 0 ) {
+                return std::signbit( t ) ? (std::memcpy( buf, "-0", 2 ), 2) : (buf[0] = '0', 1);
+            }
+            if( a >= R(1e-4) && a < R(999999.5) ) {
+                int e = a < 1 ? -1 - ( a < R(1e-1) ) - ( a < R(1e-2) ) - ( a < R(1e-3) ) :
+                    ( a >= 10 ) + ( a >= 100 ) + ( a >= 1000 ) + ( a >= 10000 ) + ( a >= 100000 );
+                R scaled = a * pow10[ 5 - e ];
+                if( scaled < 100000 ) scaled *= 10, --e;   // literal 1e-n boundaries are inexact
+                R whole = std::floor( scaled ), frac = scaled - whole;
+                if( frac < R(0.5 - 1e-6) || frac > R(0.5 + 1e-6) ) {
+                    unsigned digits = unsigned( whole ) + ( frac > R(0.5) );
+                    if( digits == 1000000 ) digits = 100000, ++e;
+                    if( e >= -4 && e <= 5 ) {
+                        char six[ 8 ], *out = buf;
+                        render_digits( six + 6, digits );
+                        if( t < 0 ) *out++ = '-';
+                        if( e >= 0 ) {
+                            std::memcpy( out, six, size_t( e + 1 ) ), out += e + 1;
+                            *out++ = '.';
+                            std::memcpy( out, six + e + 1, size_t( 5 - e ) ), out += 5 - e;
+                        } else {
+                            *out++ = '0', *out++ = '.';
+                            for( int z = -1; z > e; --z ) *out++ = '0';
+                            std::memcpy( out, six, 6 ), out += 6;
+                        }
+                        while( out[-1] == '0' ) --out;
+                        if( out[-1] == '.' ) --out;
+                        return size_t( out - buf );
+                    }
+                }
+            }
+            return render_real_printf( buf, cap, (long double)( t ) );
+        }
+
+        template< typename T >
+        inline void render( piece &p, const T &t, std::integral_constant< int, is_real > ) {
+            // float and double are exact in double math; only long double needs the wider type
+            typedef typename std::conditional< sizeof(T) <= sizeof(double), double, long double >::type R;
+            p.set( p.buf, render_real< R >( p.buf, sizeof(p.buf), R( t ) ) );
+        }
+        template< typename T >
+        inline void render( piece &p, const T &t, std::integral_constant< int, is_other > ) {
+            std::stringstream ss;
+            // a piece reused across elements (joiners) must not keep the previous text on failure
+            if( ss << t )
+                p.spill = ss.str();
+            else
+                p.spill.clear();
+            p.set( p.spill.data(), p.spill.size() );
+        }
+
+        template< typename T >
+        inline void render( piece &p, const T &t ) {
+            render( p, t, std::integral_constant< int, render_kind< T >::value >() );
+        }
+
+        // renders each argument into p[1], p[2]... (p[0] is unused, slots are 1-based)
+        inline void render_all( piece * ) {
+        }
+        template< typename T, typename... Ts >
+        inline void render_all( piece *p, const T &t, const Ts &... ts ) {
+            render( p[ 1 ], t );
+            render_all( p + 1, ts... );
         }
+
+        enum { max_slots = 31 };
+
+        // Safe formatting engine behind the wire::string constructors, operator() and $wire().
+        // \1..\37 bytes of fmt are slots; bytes without a matching argument are copied verbatim.
+        // Appends to out after growing it exactly once.
+        template< typename OUT, typename... Ts >
+        inline OUT &formatsafe( OUT &out, const char *fmt, size_t len, const Ts &... ts ) {
+            static_assert( sizeof...(Ts) <= max_slots, "wire: too many arguments for a safe format" );
+            wire$stats_into( safe_format, len, out );
+            const unsigned argc = sizeof...(Ts);
+            piece p[ sizeof...(Ts) + 1 ];
+            render_all( p, ts... );
+
+            size_t total = out.size();
+            for( size_t i = 0; i < len; ++i ) {
+                unsigned slot = (unsigned char)fmt[ i ];
+                total += slot - 1u < argc ? p[ slot ].len : 1;
+            }
+            if( out.capacity() < total )
+                out.reserve( total );
+
+            const char *run = fmt, *end = fmt + len;
+            for( const char *it = fmt; it < end; ++it ) {
+                unsigned slot = (unsigned char)*it;
+                if( slot - 1u < argc ) {
+                    if( it > run ) out.append( run, it - run );
+                    out.append( p[ slot ].ptr, p[ slot ].len );
+                    run = it + 1;
+                }
+            }
+            if( end > run ) out.append( run, end - run );
+            return out;
+        }
+
+        // per-thread buffer recycled by wire::string::operator(); busy while a format writes into it.
+        // Capacities above keep_limit are released once the format is done, not kept per thread.
+        struct scratch_buffer {
+            enum { keep_limit = 1 << 16 };
+            std::string text;
+            bool busy;
+        };
+        inline scratch_buffer &scratch() {
+            static thread_local scratch_buffer buffer = { std::string(), false };
+            return buffer;
+        }
+
+        // formatting buffer for a string using allocator A: the per-thread one above for the default
+        // allocator, else a temporary drawn from A (which a per-thread buffer could not share)
+        template< typename A >
+        struct recycled {
+            std::basic_string< char, std::char_traits< char >, A > buffer;
+            explicit recycled( const A &alloc ) : buffer( alloc ) {}
+            std::basic_string< char, std::char_traits< char >, A > &get() { return buffer; }
+        };
+        // a format nested in another one (an argument's operator<< formatting a wire::string) gets a
+        // local buffer instead, so it never overwrites the outer format's text
         template<>
-        inline unsigned char as( const std::string &self ) {
-            return self.size() == 1 ? (unsigned char)(self[0]) : (unsigned char)(as<int>(self));
+        struct recycled< std::allocator< char > > {
+            scratch_buffer &shared;
+            std::string local;
+            bool owner;
+            explicit recycled( const std::allocator< char > & ) : shared( scratch() ), owner( !shared.busy ) { shared.busy = true; }
+            ~recycled() {
+                if( !owner ) return;
+                if( shared.text.capacity() > scratch_buffer::keep_limit ) std::string().swap( shared.text );
+                shared.busy = false;
+            }
+            std::string &get() { return owner ? shared.text : local; }
+        };
+    }
+
+    // Precompiled safe format. The template is split once into literal spans and \1..\37 slots,
+    // then every call renders its arguments and writes them into an exactly sized buffer.
+    // Output is byte-identical to the wire::string( fmt, t1, ... ) constructors.
+    // usage: static const wire::fmt kv( "\1=\2;" ); log << kv( "health", 100 );
+    class fmt
+    {
+        struct span {
+            unsigned slot;          // 1..31 for slots, 0 for literals
+            size_t offset, length;
+        };
+
+        std::string tpl;
+        std::vector< span > spans;
+
+        public:
+
+        fmt( const std::string &format ) : tpl( format )
+        {
+            for( size_t i = 0, end = tpl.size(); i < end; ) {
+                unsigned slot = (unsigned char)tpl[ i ];
+                if( slot - 1u < unsigned(max_slots) ) {
+                    span s = { slot, i, 1 };
+                    spans.push_back( s ), ++i;
+                } else {
+                    span s = { 0, i, 0 };
+                    while( i < end && unsigned( (unsigned char)tpl[ i ] - 1u ) >= unsigned(max_slots) ) ++i;
+                    s.length = i - s.offset;
+                    spans.push_back( s );
+                }
+            }
+        }
+
+        const std::string &str() const {
+            return tpl;
+        }
+
+        // appends the formatted result to out, growing it at most once
+        template< typename... Ts >
+        std::string &append( std::string &out, const Ts &... ts ) const {
+            enum { argc = sizeof...(Ts) };
+            static_assert( sizeof...(Ts) <= max_slots, "wire: too many arguments for a safe format" );
+            wire$stats_into( safe_format, tpl.size(), out );
+            piece p[ argc + 1 ];
+            render_all( p, ts... );
+
+            size_t total = out.size() + length( p, argc );
+            if( out.capacity() < total )
+                out.reserve( total );
+            return emit( out, p, argc );
+        }
+
+        // result size for the arguments already rendered into p[1..argc]
+        size_t length( const piece *p, unsigned argc ) const {
+            size_t total = 0;
+            for( const span &s : spans )
+                total += s.slot && s.slot <= argc ? p[ s.slot ].len : s.length;
+            return total;
+        }
+
+        // appends the result for the arguments already rendered into p[1..argc] (to a string or sink)
+        template< typename OUT >
+        OUT &emit( OUT &out, const piece *p, unsigned argc ) const {
+            for( const span &s : spans ) {
+                if( s.slot && s.slot <= argc )
+                    out.append( p[ s.slot ].ptr, p[ s.slot ].len );
+                else
+                    out.append( &tpl[ s.offset ], s.length );
+            }
+            return out;
+        }
+
+        // replaces out contents with the formatted result, reusing its capacity
+        template< typename... Ts >
+        std::string &to( std::string &out, const Ts &... ts ) const {
+            out.clear();
+            return append( out, ts... );
+        }
+
+        // streams the result to out
+        template< typename... Ts >
+        sink &to( sink &out, const Ts &... ts ) const {
+            enum { argc = sizeof...(Ts) };
+            static_assert( sizeof...(Ts) <= max_slots, "wire: too many arguments for a safe format" );
+            wire$stats( safe_format, tpl.size() );
+            piece p[ argc + 1 ];
+            render_all( p, ts... );
+            wire$stats_out( length( p, argc ), 0 );
+            return emit( out, p, argc );
+        }
+
+        template< typename... Ts >
+        std::string operator()( const Ts &... ts ) const {
+            std::string out;
+            append( out, ts... );
+            return out;
+        }
+    };
+
+    namespace
+    {
+        // Element -> format arguments adaptors for the joiners: the element itself, a pair's first,
+        // second, or both. sizable<E> tells whether the arguments are cheap to render (text, chars,
+        // bools, integers), in which case the joiners afford a sizing pass and grow the output once.
+        // Reals and streamed types are rendered once and the output grows geometrically instead.
+        template< typename T >
+        struct renders_inline {
+            enum { kind = render_kind< typename std::remove_cv< T >::type >::value };
+            enum { value = int( kind ) != int( is_real ) && int( kind ) != int( is_other ) };
+        };
+        struct pick_element {
+            template< typename E > struct sizable : renders_inline< E > {};
+            template< typename E > static unsigned args( piece *p, const E &e ) {
+                return render( p[1], e ), 1;
+            }
+        };
+        struct pick_first {
+            template< typename E > struct sizable : renders_inline< typename E::first_type > {};
+            template< typename E > static unsigned args( piece *p, const E &e ) {
+                return render( p[1], e.first ), 1;
+            }
+        };
+        struct pick_second {
+            template< typename E > struct sizable : renders_inline< typename E::second_type > {};
+            template< typename E > static unsigned args( piece *p, const E &e ) {
+                return render( p[1], e.second ), 1;
+            }
+        };
+        struct pick_both {
+            template< typename E > struct sizable {
+                enum { value = renders_inline< typename E::first_type >::value && renders_inline< typename E::second_type >::value };
+            };
+            template< typename E > static unsigned args( piece *p, const E &e ) {
+                return render( p[1], e.first ), render( p[2], e.second ), 2;
+            }
+        };
+
+        // Same output as wire::fmt, walking the template bytes on every call instead of parsing them
+        // into spans up front, so it never allocates. For joiners that must only draw memory from the
+        // caller's allocator (basic_strings::str()).
+        struct raw_format {
+            const char *tpl;
+            size_t len;
+
+            // end of the literal run starting at i
+            size_t literal_end( size_t i ) const {
+                while( i < len && unsigned( (unsigned char)tpl[ i ] - 1u ) >= unsigned(max_slots) ) ++i;
+                return i;
+            }
+
+            size_t length( const piece *p, unsigned argc ) const {
+                size_t total = 0;
+                for( size_t i = 0; i < len; ) {
+                    unsigned slot = (unsigned char)tpl[ i ];
+                    if( slot - 1u < unsigned(max_slots) ) {
+                        total += slot <= argc ? p[ slot ].len : 1, ++i;
+                        continue;
+                    }
+                    size_t k = literal_end( i + 1 );
+                    total += k - i, i = k;
+                }
+                return total;
+            }
+
+            template< typename OUT >
+            OUT &emit( OUT &out, const piece *p, unsigned argc ) const {
+                for( size_t i = 0; i < len; ) {
+                    unsigned slot = (unsigned char)tpl[ i ];
+                    if( slot - 1u < unsigned(max_slots) ) {
+                        if( slot <= argc ) out.append( p[ slot ].ptr, p[ slot ].len );
+                        else out.append( tpl + i, 1 );
+                        ++i;
+                        continue;
+                    }
+                    size_t k = literal_end( i + 1 );
+                    out.append( tpl + i, k - i ), i = k;
+                }
+                return out;
+            }
+        };
+
+        template< typename PICK, typename A, typename IT, typename FORMAT >
+        inline void presize( std::basic_string< char, std::char_traits< char >, A > &out, IT it, IT end, const FORMAT &format, size_t extra, piece *p ) {
+            typedef typename std::iterator_traits< IT >::value_type element;
+            if( PICK::template sizable< element >::value ) {
+                size_t total = out.size() + extra;
+                for( ; it != end; ++it )
+                    total += format.length( p, PICK::args( p, *it ) );
+                out.reserve( total );
+            }
+        }
+        template< typename PICK, typename IT, typename FORMAT >
+        inline void presize( sink &, IT, IT, const FORMAT &, size_t, piece * )
+        {}
+
+        // appends pre, then format (a fmt or raw_format) applied to every element of [it, end), then post
+        // (to a string or sink)
+        template< typename PICK, typename OUT, typename IT, typename FORMAT >
+        inline OUT &join( OUT &out, IT it, IT end, const FORMAT &format, const std::string &pre, const std::string &post ) {
+            piece p[ 3 ];
+            presize< PICK >( out, it, end, format, pre.size() + post.size(), p );
+            out.append( pre.data(), pre.size() );
+            for( ; it != end; ++it )
+                format.emit( out, p, PICK::args( p, *it ) );
+            return out.append( post.data(), post.size() );
+        }
+    }
+
+    namespace
+    {
+        inline unsigned lowest_bit( unsigned mask ) {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward( &index, mask );
+            return unsigned( index );
+#else
+            return unsigned( __builtin_ctz( mask ) );
+#endif
+        }
+
+        inline unsigned highest_bit( unsigned mask ) {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanReverse( &index, mask );
+            return unsigned( index );
+#else
+            return unsigned( 31 - __builtin_clz( mask ) );
+#endif
+        }
+
+        // Substring search shared by count(), replace(), left_of()... Candidates are filtered by
+        // comparing the first and last needle bytes against 32 (AVX2) or 16 (SSE2) positions at once,
+        // then verified with memcmp; memchr drives the scalar path and the tail.
+        // Returns the first occurrence of [k, k+m) in [h, h+n), or 0.
+        inline const char *search( const char *h, size_t n, const char *k, size_t m ) {
+            if( m == 0 ) return h;
+            if( m > n ) return 0;
+            if( m == 1 ) return (const char *)std::memchr( h, k[0], n );
+
+            const char first = k[0], last = k[m - 1];
+            size_t i = 0;
+#ifdef wire$avx2
+            const __m256i F = _mm256_set1_epi8( first ), L = _mm256_set1_epi8( last );
+            for( ; i + m + 31 <= n; i += 32 ) {
+                __m256i a = _mm256_loadu_si256( (const __m256i *)( h + i ) );
+                __m256i b = _mm256_loadu_si256( (const __m256i *)( h + i + m - 1 ) );
+                unsigned mask = unsigned( _mm256_movemask_epi8( _mm256_and_si256( _mm256_cmpeq_epi8( a, F ), _mm256_cmpeq_epi8( b, L ) ) ) );
+                for( ; mask; mask &= mask - 1 ) {
+                    const char *p = h + i + lowest_bit( mask );
+                    if( !std::memcmp( p + 1, k + 1, m - 2 ) ) return p;
+                }
+            }
+#endif
+#ifdef wire$sse2
+            const __m128i F16 = _mm_set1_epi8( first ), L16 = _mm_set1_epi8( last );
+            // 64-byte strides that hold no first byte at all are skipped with a single test
+            for( ; i + m + 63 <= n; i += 64 ) {
+                __m128i any = _mm_or_si128(
+                    _mm_or_si128( _mm_cmpeq_epi8( _mm_loadu_si128( (const __m128i *)( h + i ) ), F16 ),
+                                  _mm_cmpeq_epi8( _mm_loadu_si128( (const __m128i *)( h + i + 16 ) ), F16 ) ),
+                    _mm_or_si128( _mm_cmpeq_epi8( _mm_loadu_si128( (const __m128i *)( h + i + 32 ) ), F16 ),
+                                  _mm_cmpeq_epi8( _mm_loadu_si128( (const __m128i *)( h + i + 48 ) ), F16 ) ) );
+                if( !_mm_movemask_epi8( any ) ) continue;
+                for( size_t j = i; j < i + 64; j += 16 ) {
+                    __m128i a = _mm_loadu_si128( (const __m128i *)( h + j ) );
+                    __m128i b = _mm_loadu_si128( (const __m128i *)( h + j + m - 1 ) );
+                    unsigned mask = unsigned( _mm_movemask_epi8( _mm_and_si128( _mm_cmpeq_epi8( a, F16 ), _mm_cmpeq_epi8( b, L16 ) ) ) );
+                    for( ; mask; mask &= mask - 1 ) {
+                        const char *p = h + j + lowest_bit( mask );
+                        if( !std::memcmp( p + 1, k + 1, m - 2 ) ) return p;
+                    }
+                }
+            }
+            for( ; i + m + 15 <= n; i += 16 ) {
+                __m128i a = _mm_loadu_si128( (const __m128i *)( h + i ) );
+                __m128i b = _mm_loadu_si128( (const __m128i *)( h + i + m - 1 ) );
+                unsigned mask = unsigned( _mm_movemask_epi8( _mm_and_si128( _mm_cmpeq_epi8( a, F16 ), _mm_cmpeq_epi8( b, L16 ) ) ) );
+                for( ; mask; mask &= mask - 1 ) {
+                    const char *p = h + i + lowest_bit( mask );
+                    if( !std::memcmp( p + 1, k + 1, m - 2 ) ) return p;
+                }
+            }
+#endif
+            for( const char *p = h + i, *end = h + n - m + 1; p < end; ++p ) {
+                p = (const char *)std::memchr( p, first, size_t( end - p ) );
+                if( !p ) return 0;
+                if( p[ m - 1 ] == last && !std::memcmp( p + 1, k + 1, m - 2 ) ) return p;
+            }
+            return 0;
+        }
+
+        // non-overlapping occurrences, scanning left to right
+        inline size_t occurrences( const char *h, size_t n, const char *k, size_t m ) {
+            size_t hits = 0;
+            if( m )
+                for( const char *end = h + n; ( h = search( h, size_t( end - h ), k, m ) ) != 0; h += m )
+                    ++hits;
+            return hits;
+        }
+    }
+
+    // 256-bit byte set. Sets of up to 16 distinct bytes also keep them listed, so the scanners
+    // below can test 16 input bytes against every member at once.
+    struct charset {
+        unsigned bits[ 8 ];
+        char members[ 16 ];
+        unsigned count;     // distinct members, or 17 once the list no longer fits
+
+        charset( const char *s, size_t n ) : count(0) {
+            std::memset( bits, 0, sizeof(bits) );
+            for( size_t i = 0; i < n; ++i ) {
+                unsigned char c = (unsigned char)s[i];
+                if( has( c ) ) continue;
+                bits[ c >> 5 ] |= 1u << ( c & 31 );
+                if( count < 16 ) members[ count ] = char( c );
+                if( count < 17 ) ++count;
+            }
+        }
+
+        bool has( unsigned char c ) const {
+            return ( bits[ c >> 5 ] >> ( c & 31 ) ) & 1;
+        }
+    };
+
+    namespace
+    {
+#ifdef wire$sse2
+        // bit i set when p[i] belongs to set (set.count <= 16)
+        inline unsigned member_mask16( const char *p, const __m128i *sets, unsigned count ) {
+            __m128i v = _mm_loadu_si128( (const __m128i *)p ), hits = _mm_cmpeq_epi8( v, sets[0] );
+            for( unsigned j = 1; j < count; ++j )
+                hits = _mm_or_si128( hits, _mm_cmpeq_epi8( v, sets[j] ) );
+            return unsigned( _mm_movemask_epi8( hits ) );
+        }
+#endif
+
+        // first byte of [p, e) inside (or outside, when !inside) set, or e.
+        // Short runs are the common case, so the first 16 bytes are tested one by one.
+        template< bool inside >
+        inline const char *scan_set( const char *p, const char *e, const charset &set ) {
+            for( const char *head = e - p > 16 ? p + 16 : e; p < head; ++p )
+                if( set.has( (unsigned char)*p ) == inside ) return p;
+#ifdef wire$sse2
+            if( set.count && set.count <= 16 && e - p >= 16 ) {
+                __m128i sets[ 16 ];
+                for( unsigned j = 0; j < set.count; ++j ) sets[j] = _mm_set1_epi8( set.members[j] );
+                for( ; e - p >= 16; p += 16 ) {
+                    unsigned mask = member_mask16( p, sets, set.count );
+                    if( !inside ) mask ^= 0xFFFF;
+                    if( mask ) return p + lowest_bit( mask );
+                }
+            }
+#endif
+            while( p < e && set.has( (unsigned char)*p ) != inside ) ++p;
+            return p;
+        }
+        inline const char *find_in( const char *p, const char *e, const charset &set ) {
+            return scan_set< true >( p, e, set );
+        }
+        inline const char *find_not_in( const char *p, const char *e, const charset &set ) {
+            return scan_set< false >( p, e, set );
+        }
+
+        // one past the last byte of [p, e) outside set, or p
+        inline const char *rfind_not_in( const char *p, const char *e, const charset &set ) {
+#ifdef wire$sse2
+            if( set.count && set.count <= 16 && e - p >= 16 ) {
+                __m128i sets[ 16 ];
+                for( unsigned j = 0; j < set.count; ++j ) sets[j] = _mm_set1_epi8( set.members[j] );
+                for( ; e - p >= 16; e -= 16 ) {
+                    unsigned mask = member_mask16( e - 16, sets, set.count ) ^ 0xFFFF;
+                    if( mask ) return e - 16 + highest_bit( mask ) + 1;
+                }
+            }
+#endif
+            while( e > p && set.has( (unsigned char)e[-1] ) ) --e;
+            return e;
+        }
+
+        // " \t\n\v\f\r", as std::isspace in the C locale
+        inline bool is_space( char c ) {
+            return c == ' ' || unsigned( c - '\t' ) < 5;
+        }
+
+#ifdef wire$sse2
+        // bit i set when p[i] is a space; '\t'..'\r' are tested with a single range compare
+        inline unsigned space_mask16( const char *p ) {
+            __m128i v = _mm_loadu_si128( (const __m128i *)p );
+            __m128i controls = _mm_cmplt_epi8( _mm_add_epi8( v, _mm_set1_epi8( char( 0x80 - '\t' ) ) ), _mm_set1_epi8( char( -128 + 5 ) ) );
+            return unsigned( _mm_movemask_epi8( _mm_or_si128( controls, _mm_cmpeq_epi8( v, _mm_set1_epi8( ' ' ) ) ) ) );
+        }
+#endif
+
+        // first non-space of [p, e), or e
+        inline const char *lstrip_spaces( const char *p, const char *e ) {
+#ifdef wire$sse2
+            for( ; e - p >= 16; p += 16 ) {
+                unsigned mask = space_mask16( p ) ^ 0xFFFF;
+                if( mask ) return p + lowest_bit( mask );
+            }
+#endif
+            while( p < e && is_space( *p ) ) ++p;
+            return p;
+        }
+
+        // one past the last non-space of [p, e), or p
+        inline const char *rstrip_spaces( const char *p, const char *e ) {
+#ifdef wire$sse2
+            for( ; e - p >= 16; e -= 16 ) {
+                unsigned mask = space_mask16( e - 16 ) ^ 0xFFFF;
+                if( mask ) return e - 16 + highest_bit( mask ) + 1;
+            }
+#endif
+            while( e > p && is_space( e[-1] ) ) --e;
+            return e;
+        }
+    }
+
+    // Input iterator over a lazy range of views: pulls every element with range.next( view & ).
+    template< typename RANGE >
+    class view_iterator
+    {
+        RANGE *owner;
+        view current;
+
+        public:
+
+        typedef std::input_iterator_tag iterator_category;
+        typedef view value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const view *pointer;
+        typedef const view &reference;
+
+        view_iterator() : owner(0)
+        {}
+        explicit view_iterator( RANGE *range ) : owner(range) {
+            ++*this;
+        }
+
+        const view &operator *() const { return current; }
+        const view *operator ->() const { return &current; }
+        view_iterator &operator ++() {
+            if( owner && !owner->next( current ) ) owner = 0;
+            return *this;
+        }
+        bool operator ==( const view_iterator &other ) const { return owner == other.owner; }
+        bool operator !=( const view_iterator &other ) const { return owner != other.owner; }
+    };
+
+    // Lazy string::tokenize(): yields the non-empty runs between delimiter bytes as views into the
+    // scanned buffer, which must outlive the range. Tokens are found on demand and nothing is allocated.
+    //   for( wire::view field : line.tokenize_view(",;") ) ...
+    class tokenizer
+    {
+        const char *cur, *stop;
+        charset delimiters;
+
+        public:
+
+        typedef view_iterator< tokenizer > iterator;
+
+        tokenizer( const char *begin, size_t len, const std::string &delims )
+        : cur(begin), stop(begin + len), delimiters(delims.data(), delims.size())
+        {}
+
+        // stores the next token in out; false once the input is exhausted
+        bool next( view &out ) {
+            cur = find_not_in( cur, stop, delimiters );
+            if( cur == stop ) return false;
+            const char *end = find_in( cur, stop, delimiters );
+            out = view( cur, size_t( end - cur ) );
+            cur = end;
+            return true;
+        }
+
+        iterator begin() { return iterator( this ); }
+        iterator end() { return iterator(); }
+    };
+
+    // Lazy string::split(): same elements as split() (non-empty runs, and every delimiter byte as a
+    // one-char element of its own) as views into the scanned buffer, which must outlive the range.
+    class splitter
+    {
+        const char *cur, *stop;
+        charset delimiters;
+        view pending;
+
+        public:
+
+        typedef view_iterator< splitter > iterator;
+
+        splitter( const char *begin, size_t len, const std::string &delims )
+        : cur(begin), stop(begin + len), delimiters(delims.data(), delims.size())
+        {}
+
+        // stores the run up to the next delimiter (maybe empty) and that delimiter (empty at the end
+        // of the input); false once the input is exhausted
+        bool next( view &token, view &separator ) {
+            if( cur == stop ) return false;
+            const char *end = find_in( cur, stop, delimiters );
+            token = view( cur, size_t( end - cur ) );
+            separator = view( end, end < stop ? 1 : 0 );
+            cur = end + separator.size();
+            return true;
+        }
+
+        // stores the next split() element in out; false once the input is exhausted
+        bool next( view &out ) {
+            if( !pending.empty() ) {
+                out = pending, pending = view();
+                return true;
+            }
+            view token;
+            if( !next( token, pending ) ) return false;
+            if( token.empty() ) out = pending, pending = view();
+            else out = token;
+            return true;
+        }
+
+        iterator begin() { return iterator( this ); }
+        iterator end() { return iterator(); }
+    };
+
+    namespace
+    {
+        // case folding as done by std::toupper in the C locale
+        inline char ascii_upper( char c ) {
+            return unsigned( c - 'a' ) < 26u ? char( c - ('a' - 'A') ) : c;
+        }
+
+#ifdef wire$sse2
+        // folds the 'a'..'z' (or 'A'..'Z') lanes of v by flipping their 0x20 bit
+        inline __m128i ascii_flip16( __m128i v, char from ) {
+            __m128i shifted = _mm_add_epi8( v, _mm_set1_epi8( char( 0x80 - from ) ) );
+            __m128i in_range = _mm_cmplt_epi8( shifted, _mm_set1_epi8( char( -128 + 26 ) ) );
+            return _mm_xor_si128( v, _mm_and_si128( in_range, _mm_set1_epi8( 0x20 ) ) );
+        }
+#endif
+
+        // ASCII case mapping in place, 16 bytes at a time. Returns how many bytes were mapped:
+        // it stops at the first non-ASCII byte, where the caller carries on with the C locale.
+        inline size_t ascii_case( char *s, size_t n, bool upper ) {
+            const char from = upper ? 'a' : 'A';
+            size_t i = 0;
+#ifdef wire$sse2
+            for( ; i + 16 <= n; i += 16 ) {
+                __m128i v = _mm_loadu_si128( (const __m128i *)( s + i ) );
+                if( _mm_movemask_epi8( v ) ) break;
+                _mm_storeu_si128( (__m128i *)( s + i ), ascii_flip16( v, from ) );
+            }
+#endif
+            for( ; i < n && (unsigned char)s[i] < 0x80; ++i )
+                if( unsigned( s[i] - from ) < 26u ) s[i] ^= 0x20;
+            return i;
+        }
+
+        // case-insensitive (ASCII) equality of two equally long ranges, without copies
+        inline bool equals_i( const char *a, const char *b, size_t n ) {
+            size_t i = 0;
+#ifdef wire$sse2
+            for( ; i + 16 <= n; i += 16 ) {
+                __m128i x = ascii_flip16( _mm_loadu_si128( (const __m128i *)( a + i ) ), 'a' );
+                __m128i y = ascii_flip16( _mm_loadu_si128( (const __m128i *)( b + i ) ), 'a' );
+                if( _mm_movemask_epi8( _mm_cmpeq_epi8( x, y ) ) != 0xFFFF ) return false;
+            }
+#endif
+            for( ; i < n; ++i )
+                if( ascii_upper( a[i] ) != ascii_upper( b[i] ) ) return false;
+            return true;
+        }
+
+        // case-insensitive (ASCII) three-way comparison, ordered as the upper-cased strings are
+        inline int compare_i( const char *a, size_t na, const char *b, size_t nb ) {
+            size_t n = na < nb ? na : nb, i = 0;
+            while( i + 16 <= n && equals_i( a + i, b + i, 16 ) ) i += 16;
+            while( i < n && ascii_upper( a[i] ) == ascii_upper( b[i] ) ) ++i;
+            if( i < n ) return (unsigned char)ascii_upper( a[i] ) < (unsigned char)ascii_upper( b[i] ) ? -1 : 1;
+            return na < nb ? -1 : na > nb;
+        }
+
+        struct same_char {
+            bool operator()( char p, char s ) const { return p == s; }
+        };
+        struct same_char_folded {
+            bool operator()( char p, char s ) const { return p == ascii_upper( s ); }   // p is folded already
+        };
+        struct same_char_icase {
+            bool operator()( char p, char s ) const { return ascii_upper( p ) == ascii_upper( s ); }
+        };
+
+        // Wildcard matcher: '*' matches any run, '?' any char but '.'. On a mismatch only the latest
+        // '*' is retried one char further on, which is enough for this syntax and bounds the work
+        // to O(n*m) without recursion.
+        template< typename EQ >
+        inline bool glob_match( const char *p, const char *pe, const char *s, const char *se, EQ eq ) {
+            const char *star = 0, *resume = 0;
+            while( s < se ) {
+                if( p < pe && *p == '*' ) {
+                    star = ++p, resume = s;
+                }
+                else if( p < pe && ( *p == '?' ? *s != '.' : eq( *p, *s ) ) ) {
+                    ++p, ++s;
+                }
+                else if( star ) {
+                    p = star, s = ++resume;
+                }
+                else return false;
+            }
+            while( p < pe && *p == '*' ) ++p;
+            return p == pe;
+        }
+    }
+
+    // Multi-pattern replacement engine behind string::replace_map(). At every position the longest
+    // matching key is replaced, as replace_map() always did, in a single pass over the input.
+    // An Aho-Corasick automaton over the reversed keys walks the input backwards and yields the
+    // longest key starting at each position in O(n); a forward pass then writes a pre-sized output.
+    // Maps made of single-byte keys skip the automaton and use a byte table. Empty keys never match.
+    class replacer
+    {
+        std::vector< std::string > replacements;
+        std::vector< size_t > lengths;
+        size_t longest_key;
+
+        int bytes[ 256 ];               // key per byte, when every key is a single byte
+        bool bytewise;
+
+        unsigned char classes[ 256 ];   // byte -> column in the transition table (0: no key uses it)
+        unsigned columns;
+        std::vector< unsigned > next;   // state * columns + class -> state
+        std::vector< int > longest;     // state -> longest key that ends the state path, or -1
+
+        enum { window_size = 1 << 16 };
+
+        // index of the longest key starting at every position of [s, s+n), or -1
+        template< typename VECTOR >
+        void scan( const char *s, size_t n, VECTOR &found ) const {
+            found.resize( n );
+            unsigned state = 0;
+            for( size_t i = n; i-- > 0; ) {
+                state = next[ state * columns + classes[ (unsigned char)s[i] ] ];
+                found[ i ] = longest[ state ];
+            }
+        }
+
+        // The input is replaced in 64 KB windows (plus room for the longest key), so the scratch
+        // memory never outgrows one window. window() scans the one starting at base and returns its
+        // end; walk() then calls hit( i, key ) for every key replaced in it, left to right, and returns
+        // where the next window starts (a key found before the end may end past it).
+        template< typename VECTOR >
+        size_t window( const char *s, size_t n, size_t base, VECTOR &found ) const {
+            size_t stop = std::min( n, base + size_t( window_size ) );
+            if( !bytewise )
+                scan( s + base, std::min( n, stop + longest_key ) - base, found );
+            return stop;
+        }
+        template< typename VECTOR, typename FN >
+        size_t walk( const char *s, size_t base, size_t stop, const VECTOR &found, FN hit ) const {
+            size_t i = base;
+            while( i < stop ) {
+                int k = bytewise ? bytes[ (unsigned char)s[i] ] : found[ i - base ];
+                if( k < 0 ) { ++i; continue; }
+                hit( i, k );
+                i += lengths[ k ];
+            }
+            return i;
+        }
+
+        public:
+
+        replacer( const std::map< std::string, std::string > &map ) : longest_key( 0 ), bytewise( true ), columns( 1 )
+        {
+            std::fill( bytes, bytes + 256, -1 );
+            std::fill( classes, classes + 256, (unsigned char)( 0 ) );
+
+            for( const auto &kv : map ) {
+                if( kv.first.empty() ) continue;
+                bytewise &= ( kv.first.size() == 1 );
+                for( const char &ch : kv.first )
+                    if( !classes[ (unsigned char)ch ] ) classes[ (unsigned char)ch ] = (unsigned char)( columns++ );
+                lengths.push_back( kv.first.size() );
+                replacements.push_back( kv.second );
+                longest_key = std::max( longest_key, kv.first.size() );
+            }
+
+            if( bytewise ) {
+                int key = 0;
+                for( const auto &kv : map )
+                    if( kv.first.size() == 1 ) bytes[ (unsigned char)kv.first[0] ] = key++;
+                return;
+            }
+
+            // trie of reversed keys; -1 marks missing edges until failure links fill them in
+            std::vector< int > trie( columns, -1 ), terminal( 1, -1 );
+            int key = 0;
+            for( const auto &kv : map ) {
+                if( kv.first.empty() ) continue;
+                size_t state = 0;
+                for( size_t i = kv.first.size(); i-- > 0; ) {
+                    int &edge = trie[ state * columns + classes[ (unsigned char)kv.first[i] ] ];
+                    if( edge < 0 ) {
+                        edge = int( terminal.size() );
+                        terminal.push_back( -1 );
+                        trie.resize( trie.size() + columns, -1 );
+                    }
+                    state = size_t( trie[ state * columns + classes[ (unsigned char)kv.first[i] ] ] );
+                }
+                terminal[ state ] = key++;
+            }
+
+            // breadth-first failure links, folded into a full transition table
+            size_t states = terminal.size();
+            next.assign( states * columns, 0 );
+            longest.assign( states, -1 );
+            std::vector< unsigned > fail( states, 0 ), queue;
+            queue.reserve( states );
+            for( unsigned c = 1; c < columns; ++c ) {
+                int v = trie[ c ];
+                if( v > 0 ) next[ c ] = unsigned( v ), queue.push_back( unsigned( v ) );
+            }
+            longest[ 0 ] = terminal[ 0 ];
+            for( size_t q = 0; q < queue.size(); ++q ) {
+                unsigned u = queue[ q ];
+                longest[ u ] = terminal[ u ] >= 0 ? terminal[ u ] : longest[ fail[ u ] ];
+                for( unsigned c = 1; c < columns; ++c ) {
+                    int v = trie[ u * columns + c ];
+                    if( v > 0 ) {
+                        fail[ v ] = next[ fail[ u ] * columns + c ];
+                        next[ u * columns + c ] = unsigned( v );
+                        queue.push_back( unsigned( v ) );
+                    } else {
+                        next[ u * columns + c ] = next[ fail[ u ] * columns + c ];
+                    }
+                }
+            }
+        }
+
+        // appends the replaced copy of [s, s+n) to out. Every window is sized before it is written,
+        // assuming the text after it keeps its length: out grows once when the input fits in one
+        // window or later windows do not expand it, else geometrically. Scratch memory is one
+        // window, from the allocator of out.
+        template< typename A >
+        std::basic_string< char, std::char_traits< char >, A > &append( std::basic_string< char, std::char_traits< char >, A > &out, const char *s, size_t n ) const {
+            wire$stats_into( replace_map, n, out );
+            if( replacements.empty() )
+                return out.append( s, n );
+
+            std::vector< int, typename std::allocator_traits< A >::template rebind_alloc< int > > found( out.get_allocator() );
+            size_t run = 0;
+            for( size_t base = 0; base < n; ) {
+                size_t stop = window( s, n, base, found ), added = 0, removed = 0;
+                walk( s, base, stop, found, [&]( size_t, int k ) { added += replacements[ k ].size(), removed += lengths[ k ]; } );
+                size_t need = out.size() + ( n - run ) + added - removed;
+                if( out.capacity() < need )
+                    out.reserve( base ? std::max( need, out.capacity() + out.capacity() / 2 ) : need );
+                base = walk( s, base, stop, found, [&]( size_t i, int k ) {
+                    out.append( s + run, i - run );
+                    out.append( replacements[ k ] );
+                    run = i + lengths[ k ];
+                } );
+            }
+            return out.append( s + run, n - run );
+        }
+
+        // streams the replaced copy of [s, s+n) to out, in bounded memory whatever n is
+        sink &append( sink &out, const char *s, size_t n ) const {
+            wire$stats( replace_map, n );
+            std::vector< int > found;
+            size_t run = 0, written = 0;
+            for( size_t base = 0; base < n; )
+                base = walk( s, base, window( s, n, base, found ), found, [&]( size_t i, int k ) {
+                    out.append( s + run, i - run );
+                    out.append( replacements[ k ] );
+                    written += i - run + replacements[ k ].size();
+                    run = i + lengths[ k ];
+                } );
+            out.append( s + run, n - run );
+            wire$stats_out( written + n - run, 0 );
+            return out;
+        }
+
+        std::string operator()( const std::string &s ) const {
+            std::string out;
+            append( out, s.data(), s.size() );
+            return out;
+        }
+    };
+
+    namespace
+    {
+        // at() wrap-around: "hello"[5] = h, "hello"[-1] = o. size must be positive
+        inline size_t wrap_index( int pos, int size ) {
+            if( unsigned( pos ) < unsigned( size ) ) return size_t( pos );
+            return size_t( pos >= 0 ? pos % size : size - 1 + ( ( pos + 1 ) % size ) );
+        }
+        // same, for sizes past INT_MAX (mapped files)
+        inline size_t wrap_index( long long pos, size_t size ) {
+            if( pos >= 0 ) return size_t( pos ) % size;
+            return size - 1 - size_t( -( pos + 1 ) ) % size;
+        }
+    }
+
+    // wire::string is basic_string< std::allocator< char > >. Other allocators (eg, wire::pmr::string)
+    // get the same api, and every string or list a method returns uses this string's allocator.
+    template< typename ALLOC >
+    class basic_string : public std::basic_string< char, std::char_traits< char >, ALLOC >
+    {
+        public:
+
+        typedef std::basic_string< char, std::char_traits< char >, ALLOC > base_type;
+        typedef basic_string string;
+        typedef std::deque< string, typename std::allocator_traits< ALLOC >::template rebind_alloc< string > > list_type;
+
+        // basic constructors
+
+        basic_string() : base_type()
+        {}
+
+        explicit basic_string( const ALLOC &alloc ) : base_type( alloc )
+        {}
+
+        basic_string( const basic_string & ) = default;
+        basic_string( basic_string && ) = default;
+        basic_string &operator=( const basic_string & ) = default;
+        basic_string &operator=( basic_string && ) = default;
+
+        basic_string( const basic_string &s, const ALLOC &alloc ) : base_type( s, alloc )
+        {}
+
+        basic_string( basic_string &&s, const ALLOC &alloc ) : base_type( std::move( s ), alloc )
+        {}
+
+        basic_string( const base_type &s ) : base_type( s )
+        {}
+
+        basic_string( base_type &&s ) : base_type( std::move( s ) )
+        {}
+
+        basic_string &operator=( base_type &&s )
+        {
+            base_type::operator=( std::move( s ) );
+            return *this;
+        }
+
+        basic_string( const char &c ) : base_type( 1, c )
+        {}
+
+        basic_string( const char &c, size_t n ) : base_type( n, c )
+        {}
+
+        basic_string( size_t n, const char &c ) : base_type( n, c )
+        {}
+
+        basic_string( const char *cstr ) : base_type( cstr ? cstr : "" )
+        {}
+
+        basic_string( char * const &cstr ) : base_type( cstr ? cstr : "" )
+        {}
+
+        template<size_t N>
+        basic_string( const char (&cstr)[N] ) : base_type( cstr )
+        {}
+
+        // constructor sugars
+
+        // numbers are rendered locale-free straight from the stack; anything else is streamed
+        template< typename T, typename = typename std::enable_if< !std::is_convertible< T, ALLOC >::value >::type >
+        basic_string( const T &t ) : base_type()
+        {
+            piece p;
+            render( p, t );
+            this->assign( p.ptr, p.len );
+        }
+
+        template< typename T >
+        basic_string( const T &t, const ALLOC &alloc ) : base_type( alloc )
+        {
+            piece p;
+            render( p, t );
+            this->assign( p.ptr, p.len );
+        }
+
+        // extended constructors; safe formatting (up to 31 arguments, \1..\37 slots)
+
+        template< typename T1, typename... Ts, typename = typename std::enable_if< sizeof...(Ts) || !std::is_convertible< T1, ALLOC >::value >::type >
+        basic_string( const char *fmt, const T1 &t1, const Ts &... ts ) : base_type()
+        {
+            formatsafe( *this, fmt, fmt ? std::strlen( fmt ) : 0, t1, ts... );
+        }
+
+        template< typename T1, typename... Ts, typename = typename std::enable_if< sizeof...(Ts) || !std::is_convertible< T1, ALLOC >::value >::type >
+        basic_string( const std::string &fmt, const T1 &t1, const Ts &... ts ) : base_type()
+        {
+            formatsafe( *this, fmt.data(), fmt.size(), t1, ts... );
+        }
+
+        string &operator()() {
+            return *this;
+        }
+
+        // formats into a per-thread scratch buffer then swaps buffers with it, so repeated
+        // calls recycle both capacities instead of allocating a new string every time.
+        // (with a custom allocator the buffer is drawn from that allocator instead)
+        template< typename T1, typename... Ts >
+        string &operator()( const T1 &t1, const Ts &... ts ) {
+            recycled< ALLOC > buffer( this->get_allocator() );
+            base_type &out = buffer.get();
+            out.clear();
+            formatsafe( out, this->data(), this->size(), t1, ts... );
+            this->swap( out );
+            return *this;
+        }
+
+        // conversion
+
+        template< typename T >
+        T as() const
+        {
+            wire$stats( conversion, this->size() );
+            return wire::as<T>(*this);
+        }
+
+        // as<T>() that reports failures instead of falling back to (T)true/false
+        template< typename T >
+        bool try_as( T &t ) const
+        {
+            wire$stats( conversion, this->size() );
+            return wire::try_as( *this, t );
+        }
+
+        template< typename T >
+        operator T() const
+        {
+            wire$stats( conversion, this->size() );
+            return wire::as<T>(*this);
+        }
+
+        // chaining operators
+
+        template <typename T>
+        string &operator <<( const T &t )
+        {
+            piece p;
+            render( p, t );
+            this->append( p.ptr, p.len );
+            return *this;
+        }
+
+        string &operator <<( std::ostream &( *pf )(std::ostream &) )
+        {
+            return *pf == static_cast<std::ostream& ( * )(std::ostream&)>( std::endl ) ? (*this) += "\n", *this : *this;
+        }
+
+        template< typename T >
+        string &operator +=( const T &t )
+        {
+            return operator<<(t);
+        }
+
+        string &operator +=( std::ostream &( *pf )(std::ostream &) )
+        {
+            return operator<<(pf);
+        }
+
+        // assignment sugars
+
+        template< typename T >
+        string &operator=( const T &t )
+        {
+            piece p;
+            render( p, t );
+            this->assign( p.ptr, p.len );
+            return *this;
+        }
+
+        // comparison sugars
+/*
+        operator const bool() const
+        {
+            return wire::as<bool>(*this);
+        }
+*/
+        template<typename T>
+        bool operator ==( const T &t ) const
+        {
+            return wire::as<T>(*this) == string(t).as<T>();
+        }
+        bool operator ==( const string &t ) const
+        {
+            return this->compare( t ) == 0;
+        }
+        bool operator ==( const char *t ) const
+        {
+            return this->compare( t ) == 0;
+        }
+
+        // extra methods
+
+        // at() classic behaviour: "hello"[5] = undefined, "hello"[-1] = undefined
+        // at() extended behaviour: "hello"[5] = h, "hello"[-1] = o,
+
+        // at() of an empty string never throws: it returns a '\0' that is shared when read-only and
+        // per-thread (reset on every call) when writable, so it never allocates nor races
+
+        const char &at( const int &pos ) const
+        {
+            static const char empty = '\0';
+            if( this->empty() ) {
+                wire$stats( at_fallback, 0 );
+                return empty;
+            }
+            return this->base_type::operator[]( wrap_index( pos, int( this->size() ) ) );
+        }
+
+        char &at( const int &pos )
+        {
+            static thread_local char empty;
+            if( this->empty() ) {
+                wire$stats( at_fallback, 0 );
+                return empty = '\0';
+            }
+            return this->base_type::operator[]( wrap_index( pos, int( this->size() ) ) );
+        }
+
+        const char &operator[]( const int &pos ) const {
+            return this->at(pos);
+        }
+        char &operator[]( const int &pos ) {
+            return this->at(pos);
+        }
+
+        void pop_back()
+        {
+            if( this->size() )
+                this->erase( this->end() - 1 );
+        }
+
+        void pop_front()
+        {
+            if( this->size() )
+                this->erase( 0, 1 ); //this->substr( 1 ); //this->assign( this->begin() + 1, this->end() );
+        }
+
+        // in place, reusing capacity. see wire::deque_string for O(1) front insertions and removals
+        template<typename T>
+        void push_back( const T& t ) {
+            piece p;
+            render( p, t );
+            this->append( p.ptr, p.len );
+        }
+
+        template<typename T>
+        void push_front( const T& t ) {
+            piece p;
+            render( p, t );
+            if( p.ptr >= this->data() && p.ptr < this->data() + this->size() )
+                p.spill.assign( p.ptr, p.len ), p.ptr = p.spill.data();
+            this->insert( 0, p.ptr, p.len );
+        }
+
+        const char &back() const
+        {
+            return at(-1);
+        }
+
+        char &back()
+        {
+            return at(-1);
+        }
+
+        const char &front() const
+        {
+            return at(0);
+        }
+
+        char &front()
+        {
+            return at(0);
+        }
+
+        // tools
+
+        // transforming methods come in pairs: const & ones return a new string, && ones work in place
+        // on a temporary and hand its buffer over, so chains like s.strip().lowercase() copy once
+
+        base_type str( const std::string &pre = std::string(), const std::string &post = std::string() ) const &
+        {
+            base_type out( this->get_allocator() );
+            out.reserve( pre.size() + this->size() + post.size() );
+            out.append( pre ).append( *this ).append( post );
+            return out;
+        }
+        base_type str( const std::string &pre = std::string(), const std::string &post = std::string() ) &&
+        {
+            this->insert( 0, pre );
+            this->append( post );
+            return std::move( *this );
+        }
+
+        string uppercase() const &
+        {
+            return string( *this, this->get_allocator() ).uppercase();
+        }
+        string uppercase() &&
+        {
+            char *s = &this->base_type::operator[]( 0 );
+            for( size_t i = ascii_case( s, this->size(), true ); i < this->size(); ++i )
+                s[i] = char( std::toupper( (unsigned char)s[i] ) );
+            return std::move( *this );
+        }
+
+        string lowercase() const &
+        {
+            return string( *this, this->get_allocator() ).lowercase();
+        }
+        string lowercase() &&
+        {
+            char *s = &this->base_type::operator[]( 0 );
+            for( size_t i = ascii_case( s, this->size(), false ); i < this->size(); ++i )
+                s[i] = char( std::tolower( (unsigned char)s[i] ) );
+            return std::move( *this );
+        }
+
+        // case-insensitive (ASCII) comparisons, without upper-cased copies
+        bool equalsi( const std::string &other ) const
+        {
+            return this->size() == other.size() && equals_i( this->data(), other.data(), other.size() );
         }
 
-        template<>
-        inline const char *as( const std::string &self ) {
-            return self.c_str();
+        int comparei( const std::string &other ) const
+        {
+            return compare_i( this->data(), this->size(), other.data(), other.size() );
         }
-        template<>
-        inline std::string as( const std::string &self ) {
-            return self;
+
+        bool matches( const std::string &pattern ) const
+        {
+            wire$stats( matches, this->size() );
+            return glob_match( pattern.data(), pattern.data() + pattern.size(), this->data(), this->data() + this->size(), same_char() );
         }
-    }
 
-    class string : public std::string
-    {
-        public:
+        bool matchesi( const std::string &pattern ) const
+        {
+            wire$stats( matches, this->size() );
+            return glob_match( pattern.data(), pattern.data() + pattern.size(), this->data(), this->data() + this->size(), same_char_icase() );
+        }
 
-        // basic constructors
+        size_t count( const std::string &substr ) const
+        {
+            return occurrences( this->data(), this->size(), substr.data(), substr.size() );
+        }
 
-        string() : std::string()
-        {}
+        string left_of( const std::string &substring ) const
+        {
+            const char *pos = search( this->data(), this->size(), substring.data(), substring.size() );
+            if( !pos ) return string( *this, this->get_allocator() );
+            string out( this->get_allocator() );
+            out.assign( this->data(), pos );
+            return out;
+        }
 
-/*
-        string( const string &x ) : std::string()
+        string right_of( const std::string &substring ) const
         {
-            this->assign( x );
+            const char *pos = search( this->data(), this->size(), substring.data(), substring.size() ), *end = this->data() + this->size();
+            if( !pos ) return string( *this, this->get_allocator() );
+            string out( this->get_allocator() );
+            out.assign( pos < end ? pos + 1 : end, end );
+            return out;
         }
-        string &operator=( const string &other ){
-            if( this != &other ) {
+
+        string replace1( const std::string &target, const std::string &replacement ) const {
+            const char *begin = this->data(), *end = begin + this->size();
+            // an empty target is found at 0, so the replacement is prepended (as std::string::find does)
+            const char *pos = target.empty() ? begin : search( begin, this->size(), target.data(), target.size() );
+            if( !pos ) return string( *this, this->get_allocator() );
+            string out( this->get_allocator() );
+            out.reserve( this->size() - target.size() + replacement.size() );
+            out.append( begin, pos ).append( replacement ).append( pos + target.size(), end );
+            return out;
+        }
+
+        // two passes: count the hits, then build the result in a buffer allocated once
+        string replace( const std::string &target, const std::string &replacement ) const &
+        {
+            const char *begin = this->data(), *end = begin + this->size(), *k = target.data();
+            size_t m = target.size(), hits = occurrences( begin, this->size(), k, m );
+            string out( this->get_allocator() );
+            wire$stats_into( replace, this->size(), out );
+            if( !hits ) {
+                out.assign( *this );
+                return out;
             }
-            return *this;
-        }
 
-        string( string &&x ) : std::string{std::forward<std::string>(x)}
-        {}
-        string &operator=( string &&other ){
-            if( this != &other ) {
+            out.reserve( this->size() - hits * m + hits * replacement.size() );
+            for( const char *pos; ( pos = search( begin, size_t( end - begin ), k, m ) ) != 0; begin = pos + m )
+                out.append( begin, pos ).append( replacement );
+            out.append( begin, end );
+            return out;
+        }
+        // in place when the replacement is no longer than the target (so the text never grows)
+        string replace( const std::string &target, const std::string &replacement ) &&
+        {
+            char *first = &this->base_type::operator[]( 0 ), *end = first + this->size();
+            bool aliased = ( target.data() >= first && target.data() <= end ) || ( replacement.data() >= first && replacement.data() <= end );
+            if( target.empty() || replacement.size() > target.size() || aliased )
+                return static_cast< const string & >( *this ).replace( target, replacement );
+            wire$stats( replace, this->size() );
+            const char *read = first, *k = target.data();
+            char *write = first;
+            size_t m = target.size();
+            for( const char *pos; ( pos = search( read, size_t( end - read ), k, m ) ) != 0; read = pos + m ) {
+                std::memmove( write, read, size_t( pos - read ) );
+                write += pos - read;
+                std::memcpy( write, replacement.data(), replacement.size() );
+                write += replacement.size();
             }
-            return *this;
+            std::memmove( write, read, size_t( end - read ) );
+            this->resize( size_t( write + ( end - read ) - first ) );
+            wire$stats_out( this->size(), 0 );
+            return std::move( *this );
         }
-*/
 
-        /*
-        string( string &&other ) : std::string()
+        // replaces every key of the map with its value, longest key first (see wire::replacer)
+        string replace_map( const std::map< std::string, std::string > &replacements ) const
         {
-            *this = std::move(other);
+            string out( this->get_allocator() );
+            replacer( replacements ).append( out, this->data(), this->size() );
+            return out;
         }
-        */
 
-        string( const std::string &s ) : std::string( s )
-        {}
+        string replace_map( const replacer &replacements ) const
+        {
+            string out( this->get_allocator() );
+            replacements.append( out, this->data(), this->size() );
+            return out;
+        }
 
-        string( const char &c ) : std::string( 1, c )
-        {}
+        // char translation: every from[i] byte becomes to[i] (eg, replace_map("ab", "xy"))
+        template< size_t N >
+        string replace_map( const char (&from)[N], const char (&to)[N] ) const
+        {
+            unsigned char table[ 256 ];
+            for( unsigned i = 0; i < 256; ++i ) table[ i ] = (unsigned char)( i );
+            for( size_t i = 0; i + 1 < N; ++i ) table[ (unsigned char)from[i] ] = (unsigned char)( to[i] );
+            wire$stats( replace_map, this->size() );
+            string out( *this, this->get_allocator() );
+            for( char &ch : out ) ch = char( table[ (unsigned char)ch ] );
+            wire$stats_out( out.size(), out.capacity() > std::string().capacity() );
+            return out;
+        }
 
-        string( const char &c, size_t n ) : std::string( n, c )
-        {}
+        private:
 
-        string( size_t n, const char &c ) : std::string( n, c )
-        {}
+        // the span left once leading and/or trailing chars (spaces when chars is empty) are skipped
+        view strip_span( const std::string &chars, bool strip_left, bool strip_right ) const
+        {
+            const char *begin = this->data(), *end = begin + this->size();
 
-        string( const char *cstr ) : std::string( cstr ? cstr : "" )
-        {}
+            if( chars.empty() )
+            {
+                if( strip_left ) begin = lstrip_spaces( begin, end );
+                if( strip_right ) end = rstrip_spaces( begin, end );
+            }
+            else
+            {
+                charset set( chars.data(), chars.size() );
+                if( strip_left ) begin = find_not_in( begin, end, set );
+                if( strip_right ) end = rfind_not_in( begin, end, set );
+            }
 
-        string( char * const &cstr ) : std::string( cstr ? cstr : "" )
-        {}
+            return view( begin, size_t( end - begin ) );
+        }
 
-        template<size_t N>
-        string( const char (&cstr)[N] ) : std::string( cstr )
-        {}
+        string strip( const std::string &chars, bool strip_left, bool strip_right ) const
+        {
+            view v = strip_span( chars, strip_left, strip_right );
+            if( v.size() == this->size() ) return string( *this, this->get_allocator() );
+            string out( this->get_allocator() );
+            out.assign( v.data(), v.size() );
+            return out;
+        }
 
-        string( const bool &val ) : std::string( val ? "true" : "false" )
-        {}
+        string &strip_inplace( const std::string &chars, bool strip_left, bool strip_right )
+        {
+            view v = strip_span( chars, strip_left, strip_right );
+            size_t from = size_t( v.data() - this->data() );
+            this->erase( from + v.size() );
+            this->erase( 0, from );
+            return *this;
+        }
 
-        // constructor sugars
+        public: // based on python string and pystring
 
-        template< typename T >
-        string( const T &t ) : std::string()
+        // Return a copy of the string with leading characters removed (default chars: space)
+        string lstrip( const std::string &chars = std::string() ) const &
         {
-            std::stringstream ss;
-            if( ss << /* std::boolalpha << */ t )
-                this->assign( ss.str() );
+            return strip( chars, true, false );
         }
-
-        string( const float &t ) : std::string()
+        string lstrip( const std::string &chars = std::string() ) &&
         {
-            *this = string( (long double)t );
+            return std::move( strip_inplace( chars, true, false ) );
         }
-
-        string( const double &t ) : std::string()
+        string ltrim( const std::string &chars = std::string() ) const &
         {
-            *this = string( (long double)t );
+            return strip( chars, true, false );
         }
-
-        string( const long double &t ) : std::string()
+        string ltrim( const std::string &chars = std::string() ) &&
         {
-            // enum { max_digits = std::numeric_limits<long double>::digits10 + 2 };
-            std::stringstream ss;
-            if( ss << (long double)(t) )
-                this->assign( ss.str() );
+            return std::move( strip_inplace( chars, true, false ) );
         }
 
-        // extended constructors; safe formatting
-
-        private:
-        template<unsigned N>
-        std::string &formatsafe( const std::string &fmt, std::string (&t)[N] )
+        // Return a copy of the string with trailing characters removed (default chars: space)
+        string rstrip( const std::string &chars = std::string() ) const &
         {
-            for( const unsigned char &ch : fmt ) {
-                if( ch > N ) t[0] += char(ch);
-                else t[0] += t[ ch ];
-            }
-            return t[0];
+            return strip( chars, false, true );
+        }
+        string rstrip( const std::string &chars = std::string() ) &&
+        {
+            return std::move( strip_inplace( chars, false, true ) );
+        }
+        string rtrim( const std::string &chars = std::string() ) const &
+        {
+            return strip( chars, false, true );
+        }
+        string rtrim( const std::string &chars = std::string() ) &&
+        {
+            return std::move( strip_inplace( chars, false, true ) );
         }
-        public:
 
-        template< typename T1 >
-        string( const std::string &fmt, const T1 &t1 ) : std::string()
+        // Return a copy of the string with both leading and trailing characters removed (default chars: space)
+        string strip( const std::string &chars = std::string() ) const &
+        {
+            return strip( chars, true, true );
+        }
+        string strip( const std::string &chars = std::string() ) &&
+        {
+            return std::move( strip_inplace( chars, true, true ) );
+        }
+        string trim( const std::string &chars = std::string() ) const &
+        {
+            return strip( chars, true, true );
+        }
+        string trim( const std::string &chars = std::string() ) &&
         {
-            std::string t[] = { std::string(), string(t1) };
-            assign( formatsafe( fmt, t ) );
+            return std::move( strip_inplace( chars, true, true ) );
         }
 
-        template< typename T1, typename T2 >
-        string( const std::string &fmt, const T1 &t1, const T2 &t2 ) : std::string()
+        // Same as above, as views into this string instead of copies
+        view lstrip_view( const std::string &chars = std::string() ) const
+        {
+            return strip_span( chars, true, false );
+        }
+        view rstrip_view( const std::string &chars = std::string() ) const
         {
-            std::string t[] = { std::string(), string(t1), string(t2) };
-            assign( formatsafe( fmt, t ) );
+            return strip_span( chars, false, true );
+        }
+        view strip_view( const std::string &chars = std::string() ) const
+        {
+            return strip_span( chars, true, true );
         }
 
-        template< typename T1, typename T2, typename T3 >
-        string( const std::string &fmt, const T1 &t1, const T2 &t2, const T3 &t3 ) : std::string()
+        // Same as above, erasing from this string in place
+        string &lstrip_inplace( const std::string &chars = std::string() )
+        {
+            return strip_inplace( chars, true, false );
+        }
+        string &rstrip_inplace( const std::string &chars = std::string() )
         {
-            std::string t[] = { std::string(), string(t1), string(t2), string(t3) };
-            assign( formatsafe( fmt, t ) );
+            return strip_inplace( chars, false, true );
+        }
+        string &strip_inplace( const std::string &chars = std::string() )
+        {
+            return strip_inplace( chars, true, true );
         }
 
-        template< typename T1, typename T2, typename T3, typename T4 >
-        string( const std::string &fmt, const T1 &t1, const T2 &t2, const T3 &t3, const T4 &t4 ) : std::string()
+        bool starts_with( const std::string &prefix ) const
         {
-            std::string t[] = { std::string(), string(t1), string(t2), string(t3), string(t4) };
-            assign( formatsafe( fmt, t ) );
+            return this->size() >= prefix.size() && !std::memcmp( this->data(), prefix.data(), prefix.size() );
         }
 
-        template< typename T1, typename T2, typename T3, typename T4, typename T5 >
-        string( const std::string &fmt, const T1 &t1, const T2 &t2, const T3 &t3, const T4 &t4, const T5 &t5 ) : std::string()
+        bool starts_withi( const std::string &prefix ) const
         {
-            std::string t[] = { std::string(), string(t1), string(t2), string(t3), string(t4), string(t5) };
-            assign( formatsafe( fmt, t ) );
+            return this->size() >= prefix.size() && equals_i( this->data(), prefix.data(), prefix.size() );
         }
 
-        template< typename T1, typename T2, typename T3, typename T4, typename T5, typename T6 >
-        string( const std::string &fmt, const T1 &t1, const T2 &t2, const T3 &t3, const T4 &t4, const T5 &t5, const T6 &t6 ) : std::string()
+        bool ends_with( const std::string &suffix ) const
         {
-            std::string t[] = { std::string(), string(t1), string(t2), string(t3), string(t4), string(t5), string(t6) };
-            assign( formatsafe( fmt, t ) );
+            return this->size() >= suffix.size() && !std::memcmp( this->data() + this->size() - suffix.size(), suffix.data(), suffix.size() );
         }
 
-        template< typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename T7 >
-        string( const std::string &fmt, const T1 &t1, const T2 &t2, const T3 &t3, const T4 &t4, const T5 &t5, const T6 &t6, const T7 &t7 ) : std::string()
+        bool ends_withi( const std::string &suffix ) const
         {
-            std::string t[] = { std::string(), string(t1), string(t2), string(t3), string(t4), string(t5), string(t6), string(t7) };
-            assign( formatsafe( fmt, t ) );
+            return this->size() >= suffix.size() && equals_i( this->data() + this->size() - suffix.size(), suffix.data(), suffix.size() );
         }
 
-        wire::string &operator()() {
-            return *this;
+        // non-empty runs between delimiters, as views into this string (see wire::tokenizer)
+        tokenizer tokenize_view( const std::string &delimiters ) const {
+            return tokenizer( this->data(), this->size(), delimiters );
         }
 
-        template< typename T1 >
-        wire::string &operator()( const T1 &t1 ) {
-            return assign( string( *this, t1 ) ), *this;
+        list_type tokenize( const std::string &delimiters ) const {
+            wire$stats( tokenize, this->size() );
+            list_type tokens( this->get_allocator() );
+            view token;
+            for( tokenizer range = tokenize_view( delimiters ); range.next( token ); ) {
+                tokens.push_back( string( this->get_allocator() ) );
+                tokens.back().assign( token.data(), token.size() );
+            }
+            wire$stats_list( tokens );
+            return tokens;
         }
 
-        template< typename T1, typename T2 >
-        wire::string &operator()( const T1 &t1, const T2 &t2 ) {
-            return assign( string( *this, t1, t2 ) ), *this;
+        // split() elements as views into this string (see wire::splitter)
+        splitter split_view( const std::string &delimiters ) const {
+            return splitter( this->data(), this->size(), delimiters );
         }
 
-        template< typename T1, typename T2, typename T3 >
-        wire::string &operator()( const T1 &t1, const T2 &t2, const T3 &t3 ) {
-            return assign( string( *this, t1, t2, t3 ) ), *this;
+        // tokenize_incl_separators
+        list_type split( const std::string &delimiters ) const {
+            wire$stats( split, this->size() );
+            list_type tokens( this->get_allocator() );
+            view token, separator;
+            for( splitter range = split_view( delimiters ); range.next( token, separator ); ) {
+                if( !token.empty() ) {
+                    tokens.push_back( string( this->get_allocator() ) );
+                    tokens.back().assign( token.data(), token.size() );
+                }
+                if( !separator.empty() ) tokens.push_back( string( separator[0], this->get_allocator() ) );
+            }
+            wire$stats_list( tokens );
+            return tokens;
         }
+    };
+
+    // a typedef, not a class: forward-declare basic_string and this typedef, not "class string"
+    typedef basic_string< std::allocator< char > > string;
+
+    // list of wire strings; elements and str() results use the list's allocator
+    template< typename ALLOC >
+    class basic_strings : public std::deque< basic_string< ALLOC >, typename std::allocator_traits< ALLOC >::template rebind_alloc< basic_string< ALLOC > > >
+    {
+        public:
+
+        typedef basic_string< ALLOC > string;
+        typedef typename string::list_type base_type;
+
+        basic_strings() : base_type()
+        {}
+
+        explicit basic_strings( const ALLOC &alloc ) : base_type( typename base_type::allocator_type( alloc ) )
+        {}
+
+        // adopts a tokenize()/split() result, allocator included
+        basic_strings( base_type &&list ) : base_type( std::move( list ) )
+        {}
 
-        template< typename T1, typename T2, typename T3, typename T4 >
-        wire::string &operator()( const T1 &t1, const T2 &t2, const T3 &t3, const T4 &t4 ) {
-            return assign( string( *this, t1, t2, t3, t4 ) ), *this;
+        basic_strings( const int &argc, const char **&argv ) : base_type()
+        {
+            for( int i = 0; i < argc; ++i )
+                this->push_back( argv[i] );
         }
 
-        template< typename T1, typename T2, typename T3, typename T4, typename T5 >
-        wire::string &operator()( const T1 &t1, const T2 &t2, const T3 &t3, const T4 &t4, const T5 &t5 ) {
-            return assign( string( *this, t1, t2, t3, t4, t5 ) ), *this;
+        basic_strings( const int &argc, char **&argv ) : base_type()
+        {
+            for( int i = 0; i < argc; ++i )
+                this->push_back( argv[i] );
         }
 
-        template< typename T1, typename T2, typename T3, typename T4, typename T5, typename T6 >
-        wire::string &operator()( const T1 &t1, const T2 &t2, const T3 &t3, const T4 &t4, const T5 &t5, const T6 &t6 ) {
-            return assign( string( *this, t1, t2, t3, t4, t5, t6 ) ), *this;
+        template< typename T, const size_t N >
+        basic_strings( const T (&args)[N] ) : base_type()
+        {
+            this->resize( N );
+            for( int n = 0; n < N; ++n )
+                (*this)[ n ] = args[ n ];
         }
 
-        template< typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename T7 >
-        wire::string &operator()( const T1 &t1, const T2 &t2, const T3 &t3, const T4 &t4, const T5 &t5, const T6 &t6, const T7 &t7 ) {
-            return assign( string( *this, t1, t2, t3, t4, t5, t6, t7 ) ), *this;
+        template <typename CONTAINER, typename = decltype( std::declval< const CONTAINER & >().begin() )>
+        basic_strings( const CONTAINER &other ) : base_type( other.begin(), other.end() )
+        {}
+
+        template <typename CONTAINER>
+        basic_strings &operator =( const CONTAINER &other ) {
+            if( (const void *)&other != this ) {
+                *this = basic_strings( other );
+            }
+            return *this;
         }
 
-        // conversion
+        template< typename T > basic_strings( const T &t0, const T &t1 ) : base_type()
+        { this->resize(2); (*this)[0] = t0; (*this)[1] = t1; }
+        template< typename T > basic_strings( const T &t0, const T &t1, const T &t2 ) : base_type()
+        { this->resize(3); (*this)[0] = t0; (*this)[1] = t1; (*this)[2] = t2; }
+        template< typename T > basic_strings( const T &t0, const T &t1, const T &t2, const T &t3 ) : base_type()
+        { this->resize(4); (*this)[0] = t0; (*this)[1] = t1; (*this)[2] = t2; (*this)[3] = t3; }
+        template< typename T > basic_strings( const T &t0, const T &t1, const T &t2, const T &t3, const T &t4 ) : base_type()
+        { this->resize(5); (*this)[0] = t0; (*this)[1] = t1; (*this)[2] = t2; (*this)[3] = t3; (*this)[4] = t4; }
+        template< typename T > basic_strings( const T &t0, const T &t1, const T &t2, const T &t3, const T &t4, const T &t5 ) : base_type()
+        { this->resize(6); (*this)[0] = t0; (*this)[1] = t1; (*this)[2] = t2; (*this)[3] = t3; (*this)[4] = t4; (*this)[5] = t5; }
+        template< typename T > basic_strings( const T &t0, const T &t1, const T &t2, const T &t3, const T &t4, const T &t5, const T &t6 ) : base_type()
+        { this->resize(7); (*this)[0] = t0; (*this)[1] = t1; (*this)[2] = t2; (*this)[3] = t3; (*this)[4] = t4; (*this)[5] = t5; (*this)[6] = t6; }
 
-        template< typename T >
-        T as() const
+        // same wrap-around as string::at(); an empty list yields an empty string (see string::at())
+        const string &at( const int &pos ) const
         {
-            return wire::as<T>(*this);
+            static const string empty;
+            if( this->empty() ) {
+                wire$stats( at_fallback, 0 );
+                return empty;
+            }
+            return this->base_type::operator[]( wrap_index( pos, int( this->size() ) ) );
         }
 
-        template< typename T >
-        operator T() const
+        string &at( const int &pos )
         {
-            return wire::as<T>(*this);
+            static thread_local string empty;
+            if( this->empty() ) {
+                wire$stats( at_fallback, 0 );
+                return empty.clear(), empty;
+            }
+            return this->base_type::operator[]( wrap_index( pos, int( this->size() ) ) );
         }
 
-        // chaining operators
-
-        template <typename T>
-        string &operator <<( const T &t )
-        {
-            //*this = *this + string(t);
-            this->append( string(t) );
-            return *this;
+        const string &operator[]( const int &pos ) const {
+            return at(pos);
+        }
+        string &operator[]( const int &pos ) {
+            return at(pos);
         }
 
-        string &operator <<( std::ostream &( *pf )(std::ostream &) )
+        typename string::base_type str( const char *format1 = "\1\n", const std::string &pre = std::string(), const std::string &post = std::string() ) const
         {
-            return *pf == static_cast<std::ostream& ( * )(std::ostream&)>( std::endl ) ? (*this) += "\n", *this : *this;
+            typename string::base_type out( ALLOC( this->get_allocator() ) );
+            if( this->size() == 1 )
+                return out.append( pre ).append( *this->begin() ).append( post ), out;
+
+            // the format is walked in place, so only the list's allocator is ever used
+            raw_format format = { format1, format1 ? std::strlen( format1 ) : 0 };
+            join< pick_element >( out, this->begin(), this->end(), format, pre, post );
+            return out;
         }
 
-        template< typename T >
-        string &operator +=( const T &t )
+        // same as above, streamed to out
+        sink &str( sink &out, const char *format1 = "\1\n", const std::string &pre = std::string(), const std::string &post = std::string() ) const
         {
-            return operator<<(t);
+            if( this->size() == 1 )
+                return out.append( pre ).append( *this->begin() ).append( post );
+            raw_format format = { format1, format1 ? std::strlen( format1 ) : 0 };
+            return join< pick_element >( out, this->begin(), this->end(), format, pre, post );
         }
 
-        string &operator +=( std::ostream &( *pf )(std::ostream &) )
-        {
-            return operator<<(pf);
+        inline friend std::ostream &operator <<( std::ostream &os, const basic_strings &self ) {
+            sink out( os );
+            self.str( out );
+            return os;
         }
+    };
 
-        // assignment sugars
+    typedef basic_strings< std::allocator< char > > strings;
 
-        template< typename T >
-        string &operator=( const T &t )
-        {
-            this->assign( string(t) );
-            return *this;
+#ifdef wire$pmr
+    // same strings drawing from a std::pmr::memory_resource (eg, a monotonic arena per request)
+    // usage: std::pmr::monotonic_buffer_resource arena; wire::pmr::string s( "hi", &arena );
+    namespace pmr
+    {
+        typedef basic_string< std::pmr::polymorphic_allocator< char > > string;
+        typedef basic_strings< std::pmr::polymorphic_allocator< char > > strings;
+    }
+#endif
+}
+
+// Precompiled wildcard patterns
+
+namespace wire
+{
+    // Same syntax as string::matches(): '*' any run, '?' any char but '.'.
+    // The pattern is normalized once (star runs collapsed, case folded when icase) and common
+    // shapes (exact, "abc*", "*abc", "*") skip the general matcher entirely.
+    class glob
+    {
+        enum shape { general, exact, prefix, suffix, anything };
+
+        std::string pattern;
+        bool icase;
+        shape kind;
+
+        template< typename EQ >
+        bool same( const char *p, const char *s, size_t n, EQ eq ) const {
+            for( size_t i = 0; i < n; ++i )
+                if( !eq( p[i], s[i] ) ) return false;
+            return true;
+        }
+
+        template< typename EQ >
+        bool test( const char *s, size_t n, EQ eq ) const {
+            const char *p = pattern.data();
+            size_t m = pattern.size();
+            switch( kind ) {
+                case anything: return true;
+                case exact:    return n == m && same( p, s, n, eq );
+                case prefix:   return n >= m - 1 && same( p, s, m - 1, eq );
+                case suffix:   return n >= m - 1 && same( p + 1, s + n - (m - 1), m - 1, eq );
+                default:       return glob_match( p, p + m, s, s + n, eq );
+            }
         }
 
-        // comparison sugars
-/*
-        operator const bool() const
+        public:
+
+        glob( const std::string &wildcard, bool case_insensitive = false ) : icase( case_insensitive )
         {
-            return wire::as<bool>(*this);
+            pattern.reserve( wildcard.size() );
+            for( const char &ch : wildcard ) {
+                if( ch == '*' && pattern.size() && pattern.back() == '*' ) continue;
+                pattern.push_back( icase ? ascii_upper( ch ) : ch );
+            }
+            size_t stars = std::count( pattern.begin(), pattern.end(), '*' );
+            bool marks = pattern.find( '?' ) != std::string::npos;
+            /**/ if( pattern == "*" ) kind = anything;
+            else if( marks || stars > 1 ) kind = general;
+            else if( !stars ) kind = exact;
+            else if( pattern.back() == '*' ) kind = prefix;
+            else if( pattern[0] == '*' ) kind = suffix;
+            else kind = general;
         }
-*/
-        template<typename T>
-        bool operator ==( const T &t ) const
-        {
-            return wire::as<T>(*this) == wire::string(t).as<T>();
+
+        bool matches( const char *s, size_t n ) const {
+            wire$stats( matches, n );
+            return icase ? test( s, n, same_char_folded() ) : test( s, n, same_char() );
         }
-        bool operator ==( const wire::string &t ) const
-        {
-            return this->compare( t ) == 0;
+        bool matches( const std::string &s ) const {
+            return matches( s.data(), s.size() );
         }
-        bool operator ==( const char *t ) const
-        {
-            return this->compare( t ) == 0;
+        bool operator()( const std::string &s ) const {
+            return matches( s.data(), s.size() );
         }
 
-        // extra methods
+        // number of matching entries, and the matching entries themselves
+        size_t count( const strings &all ) const {
+            size_t n = 0;
+            for( const string &s : all )
+                n += matches( s.data(), s.size() );
+            return n;
+        }
+        strings filter( const strings &all ) const {
+            strings out;
+            for( const string &s : all )
+                if( matches( s.data(), s.size() ) )
+                    out.push_back( s );
+            return out;
+        }
+    };
+}
 
-        // at() classic behaviour: "hello"[5] = undefined, "hello"[-1] = undefined
-        // at() extended behaviour: "hello"[5] = h, "hello"[-1] = o,
+// Double-ended string buffer
 
-        const char &at( const int &pos ) const
-        {
-            signed size = (signed)(this->size());
-            if( size )
-                return this->std::string::at( pos >= 0 ? pos % size : size - 1 + ((pos+1) % size) );
-            static std::map< const string *, char > map;
-            return ( ( map[ this ] = map[ this ] ) = '\0' );
+namespace wire
+{
+    // Contiguous string with spare room kept at both ends, so push_front()/pop_front() are amortized
+    // O(1) just like push_back()/pop_back(). Handy for framers that prepend headers to payloads and
+    // consume input from the front. Values are rendered as wire::string renders them.
+    class deque_string
+    {
+        std::string buf;
+        size_t head, tail;      // contents are buf[head, tail)
+
+        // guarantees front bytes of headroom and back bytes of tailroom
+        void make_room( size_t front, size_t back ) {
+            if( head >= front && buf.size() - tail >= back ) return;
+            size_t n = tail - head, need = front + n + back, at;
+            if( need * 2 <= buf.size() ) {
+                // at least half the buffer is spare: re-center the contents
+                at = front + ( buf.size() - need ) / 2;
+                std::memmove( &buf[ at ], &buf[ head ], n );
+            } else {
+                std::string bigger( need * 2 < 32 ? 32 : need * 2, '\0' );
+                at = front + ( bigger.size() - need ) / 2;
+                if( n ) std::memcpy( &bigger[ at ], &buf[ head ], n );
+                buf.swap( bigger );
+            }
+            head = at, tail = at + n;
         }
 
-        char &at( const int &pos )
-        {
-            signed size = (signed)(this->size());
-            if( size )
-                return this->std::string::at( pos >= 0 ? pos % size : size - 1 + ((pos+1) % size) );
-            static std::map< const string *, char > map;
-            return ( ( map[ this ] = map[ this ] ) = '\0' );
+        static char &sentinel() {
+            static thread_local char empty;
+            return empty = '\0';
         }
 
-        const char &operator[]( const int &pos ) const {
-            return this->at(pos);
+        template< typename T >
+        static void render_detached( piece &p, const T &t, const std::string &buf ) {
+            render( p, t );
+            if( p.ptr >= buf.data() && p.ptr < buf.data() + buf.size() )
+                p.spill.assign( p.ptr, p.len ), p.ptr = p.spill.data();
         }
-        char &operator[]( const int &pos ) {
-            return this->at(pos);
+
+        public:
+
+        deque_string() : head(0), tail(0)
+        {}
+
+        deque_string( const std::string &s ) : head(0), tail(0) {
+            append( s.data(), s.size() );
         }
 
-        void pop_back()
-        {
-            if( this->size() )
-                this->erase( this->end() - 1 );
+        size_t size() const { return tail - head; }
+        bool empty() const { return tail == head; }
+        const char *data() const { return buf.data() + head; }
+        const char *begin() const { return data(); }
+        const char *end() const { return buf.data() + tail; }
+        char &operator[]( size_t i ) { return buf[ head + i ]; }
+        char operator[]( size_t i ) const { return buf[ head + i ]; }
+
+        // an empty string yields '\0', as string::at() does
+        char &front() { return empty() ? sentinel() : buf[ head ]; }
+        char &back() { return empty() ? sentinel() : buf[ tail - 1 ]; }
+        char front() const { return empty() ? '\0' : buf[ head ]; }
+        char back() const { return empty() ? '\0' : buf[ tail - 1 ]; }
+
+        deque_string &append( const char *ptr, size_t len ) {
+            make_room( 0, len );
+            if( len ) std::memcpy( &buf[ tail ], ptr, len );
+            tail += len;
+            return *this;
         }
 
-        void pop_front()
-        {
-            if( this->size() )
-                this->erase( 0, 1 ); //this->substr( 1 ); //this->assign( this->begin() + 1, this->end() );
+        deque_string &prepend( const char *ptr, size_t len ) {
+            make_room( len, 0 );
+            head -= len;
+            if( len ) std::memcpy( &buf[ head ], ptr, len );
+            return *this;
         }
 
-        template<typename T>
-        void push_back( const T& t ) {
-            //std::swap( *this, *this + string(t) );
-            *this = *this + string(t);
+        template< typename T >
+        deque_string &push_back( const T &t ) {
+            piece p;
+            render_detached( p, t, buf );
+            return append( p.ptr, p.len );
         }
 
-        template<typename T>
-        void push_front( const T& t ) {
-            //std::swap( *this, string(t) + *this );
-            *this = string(t) + *this;
+        template< typename T >
+        deque_string &push_front( const T &t ) {
+            piece p;
+            render_detached( p, t, buf );
+            return prepend( p.ptr, p.len );
         }
 
-        const char &back() const
-        {
-            return at(-1);
+        template< typename T >
+        deque_string &operator <<( const T &t ) {
+            return push_back( t );
         }
 
-        char &back()
-        {
-            return at(-1);
+        // drop up to n bytes from either end
+        void pop_front( size_t n = 1 ) {
+            head += n < size() ? n : size();
         }
-
-        const char &front() const
-        {
-            return at(0);
+        void pop_back( size_t n = 1 ) {
+            tail -= n < size() ? n : size();
         }
 
-        char &front()
-        {
-            return at(0);
+        void clear() {
+            head = tail = buf.size() / 2;
         }
 
-        // tools
+        std::string str() const {
+            return std::string( data(), size() );
+        }
+        explicit operator std::string() const {
+            return str();
+        }
+        operator view() const {
+            return view( data(), size() );
+        }
 
-        std::string str( const std::string &pre = std::string(), const std::string &post = std::string() ) const
-        {
-            return pre + *this + post;
+        inline friend std::ostream &operator <<( std::ostream &os, const deque_string &self ) {
+            return os.write( self.data(), std::streamsize( self.size() ) );
         }
+    };
+}
+
+// Packed string lists
+
+namespace wire
+{
+    // Alternative to wire::strings for huge lists of short strings: every byte lives back to back in
+    // a single arena and element i spans [ends[i-1], ends[i]) of it, so there is one allocation per
+    // growth step instead of one per element, and elements are read as views.
+    class packed_strings
+    {
+        std::string arena;
+        std::vector< size_t > ends;
 
-        string uppercase() const
+        public:
+
+        class const_iterator
         {
-            std::string s = *this;
+            const packed_strings *owner;
+            size_t i;
+
+            public:
+
+            typedef std::random_access_iterator_tag iterator_category;
+            typedef view value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef const view *pointer;
+            typedef view reference;
+
+            const_iterator( const packed_strings *owner = 0, size_t i = 0 ) : owner(owner), i(i)
+            {}
+
+            view operator *() const { return (*owner)[ i ]; }
+            view operator []( difference_type n ) const { return (*owner)[ i + n ]; }
+            const_iterator &operator ++() { return ++i, *this; }
+            const_iterator &operator --() { return --i, *this; }
+            const_iterator operator ++( int ) { return const_iterator( owner, i++ ); }
+            const_iterator operator --( int ) { return const_iterator( owner, i-- ); }
+            const_iterator &operator +=( difference_type n ) { return i += n, *this; }
+            const_iterator &operator -=( difference_type n ) { return i -= n, *this; }
+            const_iterator operator +( difference_type n ) const { return const_iterator( owner, i + n ); }
+            const_iterator operator -( difference_type n ) const { return const_iterator( owner, i - n ); }
+            difference_type operator -( const const_iterator &other ) const { return difference_type( i - other.i ); }
+            bool operator ==( const const_iterator &other ) const { return i == other.i; }
+            bool operator !=( const const_iterator &other ) const { return i != other.i; }
+            bool operator <( const const_iterator &other ) const { return i < other.i; }
+            bool operator >( const const_iterator &other ) const { return i > other.i; }
+            bool operator <=( const const_iterator &other ) const { return i <= other.i; }
+            bool operator >=( const const_iterator &other ) const { return i >= other.i; }
+        };
+        typedef const_iterator iterator;
+
+        packed_strings()
+        {}
 
-            std::transform( s.begin(), s.end(), s.begin(), (int(*)(int)) std::toupper );
+        template< typename CONTAINER >
+        packed_strings( const CONTAINER &other ) {
+            ends.reserve( other.size() );
+            for( typename CONTAINER::const_iterator it = other.begin(), end = other.end(); it != end; ++it )
+                push_back( *it );
+        }
 
-            return s;
+        // room for count elements totalling bytes
+        void reserve( size_t count, size_t bytes ) {
+            ends.reserve( count );
+            arena.reserve( bytes );
         }
 
-        string lowercase() const
-        {
-            std::string s = *this;
+        // appends t as wire::string would render it
+        template< typename T >
+        void push_back( const T &t ) {
+            piece p;
+            render( p, t );
+            if( p.ptr >= arena.data() && p.ptr < arena.data() + arena.size() )
+                p.spill.assign( p.ptr, p.len ), p.ptr = p.spill.data();
+            arena.append( p.ptr, p.len );
+            ends.push_back( arena.size() );
+        }
 
-            std::transform( s.begin(), s.end(), s.begin(), (int(*)(int)) std::tolower );
+        void pop_back() {
+            if( ends.empty() ) return;
+            ends.pop_back();
+            arena.resize( ends.empty() ? 0 : ends.back() );
+        }
 
-            return s;
+        void clear() {
+            arena.clear(), ends.clear();
         }
 
-        bool matches( const std::string &pattern ) const
-        {
-            struct local {
-                static bool match( const char *pattern, const char *str ) {
-                    if( *pattern=='\0' ) return !*str;
-                    if( *pattern=='*' )  return match(pattern+1, str) || (*str && match(pattern, str+1));
-                    if( *pattern=='?' )  return *str && (*str != '.') && match(pattern+1, str+1);
-                    return (*str == *pattern) && match(pattern+1, str+1);
-                }
-            };
+        size_t size() const { return ends.size(); }
+        bool empty() const { return ends.empty(); }
+        // total bytes of all elements
+        size_t bytes() const { return arena.size(); }
 
-            return local::match( pattern.c_str(), (*this).c_str() );
+        view operator []( size_t i ) const {
+            size_t begin = i ? ends[ i - 1 ] : 0;
+            return view( arena.data() + begin, ends[ i ] - begin );
         }
 
-        bool matchesi( const std::string &pattern ) const
-        {
-            return this->uppercase().matches( string(pattern).uppercase() );
+        // same wrap-around as strings::at(); an empty list yields an empty view
+        view at( const int &pos ) const {
+            if( ends.empty() ) return view();
+            return (*this)[ wrap_index( pos, int( ends.size() ) ) ];
         }
+        view front() const { return at( 0 ); }
+        view back() const { return at( -1 ); }
 
-        size_t count( const std::string &substr ) const
+        const_iterator begin() const { return const_iterator( this, 0 ); }
+        const_iterator end() const { return const_iterator( this, ends.size() ); }
+
+        // same output as strings::str(), sized once up front
+        std::string str( const char *format1 = "\1\n", const std::string &pre = std::string(), const std::string &post = std::string() ) const
         {
-            size_t n = 0;
-            std::string::size_type pos = 0;
-            while( (pos = this->find( substr, pos )) != std::string::npos ) {
-                n++;
-                pos += substr.size();
-            }
-            return n;
+            if( ends.size() == 1 )
+                return pre + (*this)[0].str() + post;
+
+            std::string out;
+            join< pick_element >( out, begin(), end(), fmt( format1 ), pre, post );
+            return out;
         }
 
-        string left_of( const std::string &substring ) const
+        sink &str( sink &out, const char *format1 = "\1\n", const std::string &pre = std::string(), const std::string &post = std::string() ) const
         {
-            string::size_type pos = this->find( substring );
-            return pos == std::string::npos ? *this : (string)this->substr(0, pos);
+            if( ends.size() == 1 )
+                return out.append( pre ).append( (*this)[0].data(), (*this)[0].size() ).append( post );
+            return join< pick_element >( out, begin(), end(), fmt( format1 ), pre, post );
         }
 
-        string right_of( const std::string &substring ) const
-        {
-            std::string::size_type pos = this->find( substring );
-            return pos == std::string::npos ? *this : (string)this->substr(pos + 1);
+        operator std::vector< std::string >() const {
+            std::vector< std::string > out;
+            out.reserve( ends.size() );
+            for( size_t i = 0; i < ends.size(); ++i )
+                out.push_back( (*this)[ i ].str() );
+            return out;
         }
 
-        string replace1( const std::string &target, const std::string &replacement ) const {
-            std::string str = *this;
-            auto found = str.find(target);
-            return found == string::npos ? str : (str.replace(found, target.length(), replacement), str);
+        inline friend std::ostream &operator <<( std::ostream &os, const packed_strings &self ) {
+            sink out( os );
+            self.str( out );
+            return os;
         }
+    };
+}
 
-        string replace( const std::string &target, const std::string &replacement ) const
-        {
-            size_t found = 0;
-            std::string s = *this;
+// Interned strings
 
-            while( ( found = s.find( target, found ) ) != string::npos )
-            {
-                s.replace( found, target.length(), replacement );
-                found += replacement.length();
+namespace wire
+{
+    // Interned, immutable string: equal texts share one table entry for the whole program, so
+    // copies are a pointer, and equality and hashing are O(1). Interning takes a lock on one of 16
+    // table shards; entries are never released. Meant for the small, hot vocabularies (field names,
+    // enum words...) that get created and compared over and over.
+    class atom
+    {
+        struct entry {
+            size_t hash;
+            std::string text;
+        };
+
+        struct shard {
+            std::mutex lock;
+            std::vector< const entry * > slots;     // open addressing, power-of-two size
+            size_t used;
+            shard() : used(0)
+            {}
+        };
+
+        enum { shard_bits = 4 };
+
+        const entry *e;
+
+        static size_t hash_bytes( const char *p, size_t n ) {
+            // 64-bit FNV-1a, folded to size_t
+            unsigned long long h = 14695981039346656037ULL;
+            for( size_t i = 0; i < n; ++i )
+                h = ( h ^ (unsigned char)p[i] ) * 1099511628211ULL;
+            return size_t( h ^ ( h >> 32 ) );
+        }
+
+        // never destroyed: entries stay reachable, and atoms interned from other statics' destructors
+        // still find a live table
+        static shard *shards() {
+            static shard *table = new shard[ 1 << shard_bits ];
+            return table;
+        }
+
+        static void place( std::vector< const entry * > &slots, const entry *e ) {
+            size_t mask = slots.size() - 1, i = ( e->hash >> shard_bits ) & mask;
+            while( slots[ i ] ) i = ( i + 1 ) & mask;
+            slots[ i ] = e;
+        }
+
+        static const entry *intern( const char *p, size_t n ) {
+            size_t h = hash_bytes( p, n );
+            shard &s = shards()[ h & ( ( 1 << shard_bits ) - 1 ) ];
+            std::lock_guard< std::mutex > guard( s.lock );
+
+            if( s.slots.empty() ) s.slots.resize( 64 );
+            size_t mask = s.slots.size() - 1;
+            for( size_t i = ( h >> shard_bits ) & mask; s.slots[ i ]; i = ( i + 1 ) & mask ) {
+                const entry *e = s.slots[ i ];
+                if( e->hash == h && e->text.size() == n && !std::memcmp( e->text.data(), p, n ) )
+                    return e;
             }
 
-            return s;
+            if( ( s.used + 1 ) * 2 > s.slots.size() ) {
+                std::vector< const entry * > bigger( s.slots.size() * 2 );
+                for( const entry *e : s.slots )
+                    if( e ) place( bigger, e );
+                s.slots.swap( bigger );
+            }
+            entry *e = new entry;
+            e->hash = h;
+            e->text.assign( p, n );
+            place( s.slots, e );
+            ++s.used;
+            return e;
         }
 
-        string replace_map( const std::map< std::string, std::string > &replacements ) const
-        {
-            string out;
+        public:
 
-            for( size_t i = 0; i < this->size(); )
-            {
-                bool found = false;
-                size_t match_length = 0;
+        atom() : e( intern( "", 0 ) )
+        {}
 
-                std::map< std::string, std::string >::const_reverse_iterator it;
-                for( it = replacements.rbegin(); !found && it != replacements.rend(); ++it )
-                {
-                    const std::string &target = it->first;
-                    const std::string &replacement = it->second;
+        atom( const char *p, size_t n ) : e( intern( p, n ) )
+        {}
 
-                    if( match_length != target.size() )
-                        match_length = target.size();
+        // interns t as wire::string would render it
+        template< typename T, typename = typename std::enable_if< !std::is_same< T, atom >::value >::type >
+        atom( const T &t ) {
+            piece p;
+            render( p, t );
+            e = intern( p.ptr, p.len );
+        }
 
-                    if( this->size() - i >= target.size() )
-                    if( !std::memcmp( &this->at(int(i)), &target.at(0), (int)match_length ) )
-                    {
-                        i += target.size();
+        const std::string &str() const { return e->text; }
+        const char *c_str() const { return e->text.c_str(); }
+        const char *data() const { return e->text.data(); }
+        size_t size() const { return e->text.size(); }
+        bool empty() const { return e->text.empty(); }
+        size_t hash() const { return e->hash; }
 
-                        out += replacement;
+        operator const std::string &() const { return e->text; }
 
-                        found = true;
-                    }
-                }
+        friend bool operator ==( const atom &a, const atom &b ) { return a.e == b.e; }
+        friend bool operator !=( const atom &a, const atom &b ) { return a.e != b.e; }
+        // text order, so ordered containers iterate alphabetically
+        friend bool operator <( const atom &a, const atom &b ) { return a.e != b.e && a.e->text < b.e->text; }
 
-                if( !found )
-                    out += this->at(int(i++));
-            }
+        inline friend std::ostream &operator <<( std::ostream &os, const atom &self ) {
+            return os << self.e->text;
+        }
+    };
+}
 
-           return out;
+namespace std
+{
+    template<>
+    struct hash< wire::atom > {
+        size_t operator()( const wire::atom &a ) const {
+            return a.hash();
         }
+    };
+}
 
-        private:
+// Memory-mapped files
 
-        string strip( const std::string &chars, bool strip_left, bool strip_right ) const
-        {
-            std::string::size_type len = this->size(), i = 0, j = len, charslen = chars.size();
+namespace wire
+{
+    // Read-only view of a whole file with the const search api of wire::string, working straight
+    // on the file bytes: the file is mmap'ed (with a madvise() access hint) when WIRE_MMAP is
+    // defined on POSIX, else read into memory once. Transforms either build a wire::string or stream to a
+    // sink, so a multi-GB file can be rewritten without holding the result in memory.
+    // usage: wire::mapped_string log( "access.log" ); size_t hits = log.count( "GET " );
+    class mapped_string
+    {
+        const char *ptr;
+        size_t len;
+        bool mapped, ok;
+        std::string fallback;
 
-            if( charslen == 0 )
-            {
-                if( strip_left )
-                    while( i < len && std::isspace( this->operator[]( int(i) ) ))
-                        i++;
+        mapped_string( const mapped_string & );
+        mapped_string &operator=( const mapped_string & );
+
+        void read_all( std::FILE *fp ) {
+            char chunk[ 1 << 16 ];
+            for( size_t n; ( n = std::fread( chunk, 1, sizeof(chunk), fp ) ) > 0; )
+                fallback.append( chunk, n );
+            ok = !std::ferror( fp );
+            ptr = fallback.data(), len = fallback.size();
+        }
+
+        void unmap() {
+#ifdef wire$mmap
+            if( mapped ) ::munmap( (void *)ptr, len );
+#endif
+            ptr = "", len = 0, mapped = ok = false;
+            fallback.clear();
+        }
+
+        public:
 
-                if( strip_right && j ) {
-                    do j--; while( j >= i && std::isspace( this->operator[]( int(j) ) ));
-                    j++;
+        // sequential=false hints random access instead (eg, for lookups over an index file)
+        explicit mapped_string( const std::string &path, bool sequential = true ) : ptr(""), len(0), mapped(false), ok(false)
+        {
+#ifdef wire$mmap
+            int fd = ::open( path.c_str(), O_RDONLY );
+            if( fd < 0 ) return;
+            struct stat st;
+            if( ::fstat( fd, &st ) == 0 && S_ISREG( st.st_mode ) && st.st_size > 0 ) {
+                void *p = ::mmap( 0, size_t( st.st_size ), PROT_READ, MAP_PRIVATE, fd, 0 );
+                if( p != MAP_FAILED ) {
+                    ::madvise( p, size_t( st.st_size ), sequential ? MADV_SEQUENTIAL : MADV_RANDOM );
+                    ptr = (const char *)p, len = size_t( st.st_size ), mapped = ok = true;
                 }
             }
-            else
-            {
-                const char *sep = chars.c_str();
+            ::close( fd );
+            if( ok ) return;
+#else
+            (void)sequential;
+#endif
+            // empty, special or unmappable files
+            if( std::FILE *fp = std::fopen( path.c_str(), "rb" ) ) {
+                read_all( fp );
+                std::fclose( fp );
+            }
+        }
 
-                if( strip_left )
-                    while( i < len && std::memchr( sep, this->operator[]( int(i) ), charslen ))
-                        i++;
+        mapped_string( mapped_string &&other ) : ptr(""), len(0), mapped(false), ok(false)
+        {
+            *this = std::move( other );
+        }
 
-                if( strip_right && j ) {
-                    do j--; while( j >= i && std::memchr( sep, this->operator[]( int(j) ), charslen ));
-                    j++;
-                }
+        mapped_string &operator=( mapped_string &&other ) {
+            if( this != &other ) {
+                unmap();
+                bool fell_back = !other.mapped;
+                fallback.swap( other.fallback );
+                ptr = fell_back ? fallback.data() : other.ptr, len = other.len;
+                mapped = other.mapped, ok = other.ok;
+                other.ptr = "", other.len = 0, other.mapped = other.ok = false;
             }
+            return *this;
+        }
 
-            if( j - i == len ) return *this;
-            return this->substr( i, j - i );
+        ~mapped_string() {
+            unmap();
         }
 
-        public: // based on python string and pystring
+        // false when the file could not be opened or read
+        bool good() const { return ok; }
+        // true when the bytes are mapped rather than read into memory
+        bool is_mapped() const { return mapped; }
 
-        // Return a copy of the string with leading characters removed (default chars: space)
-        string lstrip( const std::string &chars = std::string() ) const
-        {
-            return strip( chars, true, false );
+        const char *data() const { return ptr; }
+        size_t size() const { return len; }
+        bool empty() const { return !len; }
+        const char *begin() const { return ptr; }
+        const char *end() const { return ptr + len; }
+
+        operator view() const { return view( ptr, len ); }
+        string str() const { string s; s.assign( ptr, len ); return s; }
+
+        // same wrap-around as string::at(); '\0' when empty
+        char at( long long pos ) const {
+            return len ? ptr[ wrap_index( pos, len ) ] : '\0';
         }
-        string ltrim( const std::string &chars = std::string() ) const
-        {
-            return strip( chars, true, false );
+        char operator[]( long long pos ) const {
+            return at( pos );
         }
 
-        // Return a copy of the string with trailing characters removed (default chars: space)
-        string rstrip( const std::string &chars = std::string() ) const
-        {
-            return strip( chars, false, true );
+        // search
+
+        size_t find( const std::string &substr, size_t pos = 0 ) const {
+            if( pos > len ) return std::string::npos;
+            const char *hit = search( ptr + pos, len - pos, substr.data(), substr.size() );
+            return hit ? size_t( hit - ptr ) : std::string::npos;
         }
-        string rtrim( const std::string &chars = std::string() ) const
-        {
-            return strip( chars, false, true );
+
+        size_t count( const std::string &substr ) const {
+            return occurrences( ptr, len, substr.data(), substr.size() );
         }
 
-        // Return a copy of the string with both leading and trailing characters removed (default chars: space)
-        string strip( const std::string &chars = std::string() ) const
-        {
-            return strip( chars, true, true );
+        bool matches( const std::string &pattern ) const {
+            wire$stats( matches, len );
+            return glob_match( pattern.data(), pattern.data() + pattern.size(), ptr, ptr + len, same_char() );
         }
-        string trim( const std::string &chars = std::string() ) const
-        {
-            return strip( chars, true, true );
+
+        bool matchesi( const std::string &pattern ) const {
+            wire$stats( matches, len );
+            return glob_match( pattern.data(), pattern.data() + pattern.size(), ptr, ptr + len, same_char_icase() );
         }
 
-        bool starts_with( const std::string &prefix ) const
-        {
-            return this->size() >= prefix.size() ? this->substr( 0, prefix.size() ) == prefix : false;
+        bool starts_with( const std::string &prefix ) const {
+            return len >= prefix.size() && !std::memcmp( ptr, prefix.data(), prefix.size() );
         }
 
-        bool starts_withi( const std::string &prefix ) const
-        {
-            return this->uppercase().starts_with( string(prefix).uppercase() );
+        bool starts_withi( const std::string &prefix ) const {
+            return len >= prefix.size() && equals_i( ptr, prefix.data(), prefix.size() );
         }
 
-        bool ends_with( const std::string &suffix ) const
-        {
-            return this->size() < suffix.size() ? false : this->substr( this->size() - suffix.size() ) == suffix;
+        bool ends_with( const std::string &suffix ) const {
+            return len >= suffix.size() && !std::memcmp( ptr + len - suffix.size(), suffix.data(), suffix.size() );
         }
 
-        bool ends_withi( const std::string &suffix ) const
-        {
-            return this->uppercase().ends_with( string(suffix).uppercase() );
+        bool ends_withi( const std::string &suffix ) const {
+            return len >= suffix.size() && equals_i( ptr + len - suffix.size(), suffix.data(), suffix.size() );
+        }
+
+        // tokenizing (see string::tokenize() and string::split())
+
+        tokenizer tokenize_view( const std::string &delimiters ) const {
+            return tokenizer( ptr, len, delimiters );
         }
 
         std::deque< string > tokenize( const std::string &delimiters ) const {
-            std::string map( 256, '\0' );
-            for( const unsigned char &ch : delimiters )
-                map[ ch ] = '\1';
-            std::deque< string > tokens(1);
-            for( const unsigned char &ch : *this ) {
-                /**/ if( !map.at(ch)          ) tokens.back().push_back( char(ch) );
-                else if( tokens.back().size() ) tokens.push_back( string() );
-            }
-            while( tokens.size() && !tokens.back().size() ) tokens.pop_back();
+            wire$stats( tokenize, len );
+            std::deque< string > tokens;
+            for( view token : tokenize_view( delimiters ) ) {
+                tokens.push_back( string() );
+                tokens.back().assign( token.data(), token.size() );
+            }
+            wire$stats_list( tokens );
             return tokens;
         }
 
-        // tokenize_incl_separators
+        splitter split_view( const std::string &delimiters ) const {
+            return splitter( ptr, len, delimiters );
+        }
+
         std::deque< string > split( const std::string &delimiters ) const {
-            std::string str;
+            wire$stats( split, len );
             std::deque< string > tokens;
-            for( auto &ch : *this ) {
-                if( delimiters.find_first_of( ch ) != std::string::npos ) {
-                    if( str.size() ) tokens.push_back( str ), str = "";
-                    tokens.push_back( std::string() + ch );
-                } else str += ch;
+            for( view piece : split_view( delimiters ) ) {
+                tokens.push_back( string() );
+                tokens.back().assign( piece.data(), piece.size() );
             }
-            return str.empty() ? tokens : ( tokens.push_back( str ), tokens );
+            wire$stats_list( tokens );
+            return tokens;
         }
-    };
 
-    class strings : public std::deque< string >
-    {
-        public:
+        // transforms: into a new string, or streamed to out
 
-        strings() : std::deque< string >()
-        {}
+        string replace( const std::string &target, const std::string &replacement ) const {
+            string out;
+            wire$stats_into( replace, len, out );
+            const char *begin = ptr, *stop = ptr + len;
+            if( !target.empty() )
+                for( const char *pos; ( pos = search( begin, size_t( stop - begin ), target.data(), target.size() ) ) != 0; begin = pos + target.size() )
+                    out.append( begin, pos ).append( replacement );
+            out.append( begin, stop );
+            return out;
+        }
 
-        strings( const int &argc, const char **&argv ) : std::deque< string >()
-        {
-            for( int i = 0; i < argc; ++i )
-                this->push_back( argv[i] );
+        sink &replace( sink &out, const std::string &target, const std::string &replacement ) const {
+            wire$stats( replace, len );
+            const char *begin = ptr, *stop = ptr + len;
+            size_t hits = 0;
+            if( !target.empty() )
+                for( const char *pos; ( pos = search( begin, size_t( stop - begin ), target.data(), target.size() ) ) != 0; begin = pos + target.size() )
+                    out.append( begin, size_t( pos - begin ) ).append( replacement ), ++hits;
+            out.append( begin, size_t( stop - begin ) );
+            wire$stats_out( len - hits * target.size() + hits * replacement.size(), 0 );
+            return out;
         }
 
-        strings( const int &argc, char **&argv ) : std::deque< string >()
-        {
-            for( int i = 0; i < argc; ++i )
-                this->push_back( argv[i] );
+        string replace_map( const std::map< std::string, std::string > &replacements ) const {
+            return replace_map( replacer( replacements ) );
         }
 
-        template< typename T, const size_t N >
-        strings( const T (&args)[N] ) : std::deque< string >()
-        {
-            this->resize( N );
-            for( int n = 0; n < N; ++n )
-                (*this)[ n ] = args[ n ];
+        string replace_map( const replacer &replacements ) const {
+            string out;
+            replacements.append( out, ptr, len );
+            return out;
         }
 
-        template <typename CONTAINER>
-        strings( const CONTAINER &other ) : std::deque< string >( other.begin(), other.end() )
-        {}
+        sink &replace_map( sink &out, const replacer &replacements ) const {
+            return replacements.append( out, ptr, len );
+        }
 
-        template <typename CONTAINER>
-        strings &operator =( const CONTAINER &other ) {
-            if( &other != this ) {
-                *this = strings( other );
-            }
-            return *this;
+        sink &replace_map( sink &out, const std::map< std::string, std::string > &replacements ) const {
+            return replacer( replacements ).append( out, ptr, len );
         }
+    };
+}
 
-        template< typename T > strings( const T &t0, const T &t1 ) : std::deque< string >()
-        { this->resize(2); (*this)[0] = t0; (*this)[1] = t1; }
-        template< typename T > strings( const T &t0, const T &t1, const T &t2 ) : std::deque< string >()
-        { this->resize(3); (*this)[0] = t0; (*this)[1] = t1; (*this)[2] = t2; }
-        template< typename T > strings( const T &t0, const T &t1, const T &t2, const T &t3 ) : std::deque< string >()
-        { this->resize(4); (*this)[0] = t0; (*this)[1] = t1; (*this)[2] = t2; (*this)[3] = t3; }
-        template< typename T > strings( const T &t0, const T &t1, const T &t2, const T &t3, const T &t4 ) : std::deque< string >()
-        { this->resize(5); (*this)[0] = t0; (*this)[1] = t1; (*this)[2] = t2; (*this)[3] = t3; (*this)[4] = t4; }
-        template< typename T > strings( const T &t0, const T &t1, const T &t2, const T &t3, const T &t4, const T &t5 ) : std::deque< string >()
-        { this->resize(6); (*this)[0] = t0; (*this)[1] = t1; (*this)[2] = t2; (*this)[3] = t3; (*this)[4] = t4; (*this)[5] = t5; }
-        template< typename T > strings( const T &t0, const T &t1, const T &t2, const T &t3, const T &t4, const T &t5, const T &t6 ) : std::deque< string >()
-        { this->resize(7); (*this)[0] = t0; (*this)[1] = t1; (*this)[2] = t2; (*this)[3] = t3; (*this)[4] = t4; (*this)[5] = t5; (*this)[6] = t6; }
+// Streaming tokenizers
 
-        const string &at( const int &pos ) const
-        {
-            signed size = signed(this->size());
-            if( size )
-                return *( this->begin() + ( pos >= 0 ? pos % size : size - 1 + ((pos+1) % size) ) );
-            static std::map< const strings *, string > map;
-            return ( ( map[ this ] = map[ this ] ) = string() );
-        }
+namespace wire
+{
+    // tokenize()/split() over a stream or file descriptor that is never held in memory as a whole.
+    // Input is read in fixed-size chunks into one buffer; the unfinished token at the end of a
+    // chunk is carried over to the front before the next read, so tokens straddling chunk
+    // boundaries come out whole. Memory stays at one chunk plus the longest token.
+    // Modes:
+    //   tokenize: non-empty runs between delimiter bytes, as string::tokenize()
+    //   split:    same plus every delimiter byte as an element of its own, as string::split()
+    //   lines:    every run between delimiter bytes, empty ones included, as std::getline() (use "\n")
+    // Yielded views point into the buffer and stay valid until the next call. istream reads wait for
+    // a full chunk, so prefer the file descriptor constructor (with WIRE_FD) for interactive pipes
+    // and sockets.
+    // usage: for( wire::view line : wire::token_stream( std::cin, "\n", wire::token_stream::lines ) ) ...
+    class token_stream
+    {
+        public:
 
-        string &at( const int &pos )
-        {
-            signed size = signed(this->size());
-            if( size )
-                return *( this->begin() + ( pos >= 0 ? pos % size : size - 1 + ((pos+1) % size) ) );
-            static std::map< const strings *, string > map;
-            return ( ( map[ this ] = map[ this ] ) = string() );
-        }
+        enum mode { tokenize, split, lines };
 
-        const string &operator[]( const int &pos ) const {
-            return at(pos);
-        }
-        string &operator[]( const int &pos ) {
-            return at(pos);
+        private:
+
+        std::istream *in;
+        int fd;
+        charset delimiters;
+        mode how;
+        size_t chunk, head, tail;     // buffer[head, tail) is read but not consumed yet
+        size_t scanned;               // bytes of the pending element already known to hold no delimiter
+        bool eof, failed;
+        std::string buffer;
+
+        token_stream( const token_stream & );
+        token_stream &operator=( const token_stream & );
+
+        // a single delimiter (the usual "\n") goes through memchr
+        const char *find_delimiter( const char *b, const char *e ) const {
+            if( delimiters.count != 1 ) return find_in( b, e, delimiters );
+            const char *hit = (const char *)std::memchr( b, delimiters.members[0], size_t( e - b ) );
+            return hit ? hit : e;
+        }
+
+        // moves the unconsumed tail to the front and reads one more chunk after it
+        void fill() {
+            if( head ) {
+                std::memmove( &buffer[0], &buffer[head], tail - head );
+                tail -= head, head = 0;
+            }
+            if( buffer.size() < tail + chunk )
+                buffer.resize( tail + chunk );
+            char *p = &buffer[ tail ];
+            long n = 0;
+            if( in ) {
+                in->read( p, std::streamsize( chunk ) );
+                n = long( in->gcount() );
+                failed = failed || in->bad();
+            }
+#ifdef wire$fd
+            else {
+                do n = long( wire$read( fd, p, (unsigned)( chunk < (1u << 30) ? chunk : (1u << 30) ) ) ); while( n < 0 && errno == EINTR );
+                failed = failed || n < 0;
+            }
+#endif
+            if( n > 0 ) tail += size_t( n );
+            else eof = true;
         }
 
-        std::string str( const char *format1 = "\1\n", const std::string &pre = std::string(), const std::string &post = std::string() ) const
-        {
-            if( this->size() == 1 )
-                return pre + *this->begin() + post;
+        public:
 
-            std::string out( pre );
+        typedef view_iterator< token_stream > iterator;
 
-            for( const_iterator it = this->begin(); it != this->end(); ++it )
-                out += string( format1, (*it) );
+        token_stream( std::istream &is, const std::string &delims, mode m = tokenize, size_t chunk_size = 1 << 16 )
+        : in(&is), fd(-1), delimiters(delims.data(), delims.size()), how(m), chunk(chunk_size ? chunk_size : 1), head(0), tail(0), scanned(0), eof(false), failed(false)
+        {}
 
-            return out + post;
-        }
+#ifdef wire$fd
+        token_stream( int file_descriptor, const std::string &delims, mode m = tokenize, size_t chunk_size = 1 << 16 )
+        : in(0), fd(file_descriptor), delimiters(delims.data(), delims.size()), how(m), chunk(chunk_size ? chunk_size : 1), head(0), tail(0), scanned(0), eof(false), failed(false)
+        {}
+#endif
 
-        inline friend std::ostream &operator <<( std::ostream &os, const wire::strings &self ) {
-            return os << self.str(), os;
+        // false once a read failed: the stream went bad or read() returned an error. Elements read
+        // before the failure are still yielded, so the last one may be truncated.
+        bool good() const { return !failed; }
+
+        // stores the next element in out; false once the input is exhausted.
+        // A pending element is never rescanned after a refill: the scan resumes where it stopped.
+        bool next( view &out ) {
+            for( ;; ) {
+                const char *data = buffer.data(), *b = data + head, *e = data + tail;
+                if( how == lines ) {
+                    const char *stop = find_delimiter( b + scanned, e );
+                    if( stop != e ) {
+                        out = view( b, size_t( stop - b ) ), head = size_t( stop + 1 - data ), scanned = 0;
+                        return true;
+                    }
+                    if( eof ) {
+                        out = view( b, size_t( e - b ) ), head = tail, scanned = 0;
+                        return b != e;
+                    }
+                    scanned = size_t( e - b );
+                } else {
+                    const char *start = find_not_in( b, e, delimiters );
+                    if( how == split && start != b ) {
+                        out = view( b, 1 ), head += 1;
+                        return true;
+                    }
+                    if( start != e ) {
+                        // a token that reaches the end of the buffer may continue in the next chunk
+                        // (scanned is only set while head sits on the start of that token)
+                        const char *stop = find_delimiter( start + ( start == b ? scanned : 0 ), e );
+                        if( stop != e || eof ) {
+                            out = view( start, size_t( stop - start ) ), head = size_t( stop - data ), scanned = 0;
+                            return true;
+                        }
+                        scanned = size_t( e - start );
+                    } else if( eof ) {
+                        head = tail;
+                        return false;
+                    }
+                    head = size_t( start - data );
+                }
+                fill();
+            }
         }
+
+        iterator begin() { return iterator( this ); }
+        iterator end() { return iterator(); }
     };
 }
 
@@ -810,48 +3420,65 @@ namespace wire
 
 namespace wire
 {
+    // all of them parse the format once and join straight into a single output string, sized up
+    // front when the elements are text, chars, bools or integers
+
     template<typename T>
     inline std::string str( const T& t, const std::string &format1, const std::string &pre = std::string(), const std::string &post = std::string() )
     {
-        wire::string out;
-
-        for( typename T::const_iterator it = t.begin(), end = t.end(); it != end; ++it )
-            out << wire::string( format1, *it );
-
-        return wire::string() << pre << out << post;
+        std::string out;
+        join< pick_element >( out, t.begin(), t.end(), fmt( format1 ), pre, post );
+        return out;
     }
 
     template<typename T>
     inline std::string str1( const T& t, const std::string &format1, const std::string &pre = std::string(), const std::string &post = std::string() )
     {
-        wire::string out;
-
-        for( typename T::const_iterator it = t.begin(), end = t.end(); it != end; ++it )
-            out << wire::string( format1, it->first );
-
-        return wire::string() << pre << out << post;
+        std::string out;
+        join< pick_first >( out, t.begin(), t.end(), fmt( format1 ), pre, post );
+        return out;
     }
 
     template<typename T>
     inline std::string str2( const T& t, const std::string &format1, const std::string &pre = std::string(), const std::string &post = std::string() )
     {
-        wire::string out;
+        std::string out;
+        join< pick_second >( out, t.begin(), t.end(), fmt( format1 ), pre, post );
+        return out;
+    }
+
+    template<typename T>
+    inline std::string str12( const T& t, const std::string &format12, const std::string &pre = std::string(), const std::string &post = std::string() )
+    {
+        std::string out;
+        join< pick_both >( out, t.begin(), t.end(), fmt( format12 ), pre, post );
+        return out;
+    }
 
-        for( typename T::const_iterator it = t.begin(), end = t.end(); it != end; ++it )
-            out << wire::string( format1, it->second );
+    // same as above, streamed to out
 
-        return wire::string() << pre << out << post;
+    template<typename T>
+    inline sink &str( sink &out, const T& t, const std::string &format1, const std::string &pre = std::string(), const std::string &post = std::string() )
+    {
+        return join< pick_element >( out, t.begin(), t.end(), fmt( format1 ), pre, post );
     }
 
     template<typename T>
-    inline std::string str12( const T& t, const std::string &format12, const std::string &pre = std::string(), const std::string &post = std::string() )
+    inline sink &str1( sink &out, const T& t, const std::string &format1, const std::string &pre = std::string(), const std::string &post = std::string() )
     {
-        wire::string out;
+        return join< pick_first >( out, t.begin(), t.end(), fmt( format1 ), pre, post );
+    }
 
-        for( typename T::const_iterator it = t.begin(), end = t.end(); it != end; ++it )
-            out << wire::string( format12, it->first, it->second );
+    template<typename T>
+    inline sink &str2( sink &out, const T& t, const std::string &format1, const std::string &pre = std::string(), const std::string &post = std::string() )
+    {
+        return join< pick_second >( out, t.begin(), t.end(), fmt( format1 ), pre, post );
+    }
 
-        return wire::string() << pre << out << post;
+    template<typename T>
+    inline sink &str12( sink &out, const T& t, const std::string &format12, const std::string &pre = std::string(), const std::string &post = std::string() )
+    {
+        return join< pick_both >( out, t.begin(), t.end(), fmt( format12 ), pre, post );
     }
 }
 
@@ -859,7 +3486,7 @@ namespace wire
 
 namespace wire
 {
-    // @todo: eq+sep+line is a c++11 constexpr
+    // Runtime expansion of $wire() templates (see wire::introspection), kept for compatibility
     struct parser : public wire::string {
         parser( const wire::string &fmt, const wire::string &line = std::string() ) {
             wire::strings all = line.tokenize(", \r\n\t");
@@ -875,11 +3502,112 @@ namespace wire
             assign( str12(results, fmt) );
         }
     };
+
+    // $wire() engine. The stringified argument list is split into names once per call site (the
+    // macro keeps one of these in a function-local static), so each trace only renders its values.
+    // The output matches what parser() + string::operator() produced: FMT is repeated once per name,
+    // with \1 standing for the name, \2 for its value and any other \3..\37 for that argument.
+    class introspection
+    {
+        std::vector< std::string > names;
+
+        struct counter {
+            size_t n;
+            counter &append( const char *, size_t len ) { return n += len, *this; }
+        };
+
+        template< typename OUT >
+        OUT &emit( OUT &out, const char *fmt, size_t len, const piece *p, unsigned argc ) const {
+            for( size_t i = 0; i < names.size(); ++i ) {
+                for( size_t j = 0; j < len; ) {
+                    unsigned c = (unsigned char)fmt[ j ];
+                    if( c - 1u >= unsigned(max_slots) ) {
+                        size_t k = j + 1;
+                        while( k < len && unsigned( (unsigned char)fmt[ k ] - 1u ) >= unsigned(max_slots) ) ++k;
+                        out.append( fmt + j, k - j );
+                        j = k;
+                        continue;
+                    }
+                    ++j;
+                    if( c == 1 ) {
+                        out.append( names[ i ].data(), names[ i ].size() );
+                        continue;
+                    }
+                    if( c == 2 ) c = (unsigned char)( i + 1 );
+                    if( c - 1u < unsigned(max_slots) && c <= argc ) {
+                        out.append( p[ c ].ptr, p[ c ].len );
+                    } else {
+                        char literal = char( c );
+                        out.append( &literal, 1 );
+                    }
+                }
+            }
+            return out;
+        }
+
+        template< typename... Ts >
+        wire::string format( const char *fmt, size_t len, const Ts &... ts ) const {
+            enum { argc = sizeof...(Ts) };
+            piece p[ argc + 1 ];
+            render_all( p, ts... );
+            counter size = { 0 };
+            emit( size, fmt, len, p, argc );
+            wire::string out;
+            out.reserve( size.n );
+            emit( out, fmt, len, p, argc );
+            return out;
+        }
+
+        public:
+
+        explicit introspection( const char *line ) {
+            wire::string args( line );
+            view token;
+            for( tokenizer range = args.tokenize_view( ", \r\n\t" ); range.next( token ); )
+                names.push_back( wire::string( token.str() ).right_of(".").right_of("->") );
+        }
+
+        template< typename... Ts >
+        wire::string operator()( const char *fmt, const Ts &... ts ) const {
+            return format( fmt, fmt ? std::strlen( fmt ) : 0, ts... );
+        }
+        template< typename... Ts >
+        wire::string operator()( const std::string &fmt, const Ts &... ts ) const {
+            return format( fmt.data(), fmt.size(), ts... );
+        }
+
+        template< typename... Ts >
+        sink &to( sink &out, const char *fmt, const Ts &... ts ) const {
+            piece p[ sizeof...(Ts) + 1 ];
+            render_all( p, ts... );
+            return emit( out, fmt, fmt ? std::strlen( fmt ) : 0, p, sizeof...(Ts) );
+        }
+        template< typename... Ts >
+        sink &to( sink &out, const std::string &fmt, const Ts &... ts ) const {
+            piece p[ sizeof...(Ts) + 1 ];
+            render_all( p, ts... );
+            return emit( out, fmt.data(), fmt.size(), p, sizeof...(Ts) );
+        }
+    };
 }
 
-#define $wire(FMT,...) wire::parser(FMT,#__VA_ARGS__)(__VA_ARGS__)
+#define wire$site(...) ( []() -> const wire::introspection & { static const wire::introspection site( #__VA_ARGS__ ); return site; }() )
+#define $wire(FMT,...) wire$site(__VA_ARGS__)(FMT,__VA_ARGS__)
+#define $wire_to(SINK,FMT,...) wire$site(__VA_ARGS__).to(SINK,FMT,__VA_ARGS__)
 
 #ifdef _MSC_VER
 #    pragma warning( pop )
 #endif
 #undef wire$vsnprintf
+#undef wire$fd
+#undef wire$read
+#undef wire$write
+#undef wire$mmap
+#undef wire$sse2
+#undef wire$avx2
+#undef wire$cpp17
+#undef wire$pmr
+#undef wire$stats
+#undef wire$stats_into
+#undef wire$stats_out
+#undef wire$stats_list